@@ -0,0 +1,92 @@
+/*
+ * This file is part of Codespeak.
+ *
+ * Codespeak is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * Codespeak is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Codespeak.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ *
+ * The interpreter as a library: contexts (a root environment each)
+ * that evaluate lines as the interpreter reads them, and keep their
+ * symbols from one evaluation to the next. Contexts may evaluate in
+ * different threads at the same time, each one text at a time.
+ *
+ * gcc -std=gnu99 -Wall -g -pthread -I./libgrapheme/include -DCODESPEAK_LIB -c phrase.c
+ * ar rcs libcodespeak.a phrase.o
+ * (link with -lcodespeak -lgrapheme -pthread)
+ *
+ */
+
+#ifndef CODESPEAK_H
+#define CODESPEAK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* an interpreter context */
+typedef struct Cs_ Cs;
+
+/* results of cs_eval */
+typedef enum {
+	CS_FAIL,	/* a line failed, its message was output */
+	CS_OK,
+	CS_LIMIT	/* a line hit a limit (fuel, time, calls), and was abandoned */
+} cs_rc;
+
+/* kinds of values read back */
+typedef enum {
+	CS_NONE,	/* undefined */
+	CS_NAT,
+	CS_REAL,
+	CS_LIST,	/* list, array or vector */
+	CS_OTHER	/* big natural, function, ... */
+} cs_kind;
+
+/* a new context, with an empty root environment, NULL if out of memory */
+Cs *cs_new(void);
+void cs_free(Cs *c);
+
+/* adds the symbols saved in an image (see save-image) to c,
+ * false if it is not valid */
+bool cs_image(Cs *c, const char *path);
+/* debug reports of c's parser, --opt and --jit, in its output */
+void cs_debug(Cs *c, bool on);
+/* compiles c's hot numeric functions (x86-64), off at first */
+void cs_jit(Cs *c, bool on);
+/* optimizes the bodies of the functions c defines (as --opt), off at first */
+void cs_opt(Cs *c, bool on);
+/* limits of each line c evaluates: fuel steps, ms milliseconds
+ * (0 for no limit), depth nested calls (0 for the default, 5000);
+ * a line past one is abandoned (CS_LIMIT) */
+void cs_limits(Cs *c, size_t fuel, long ms, size_t depth);
+
+/* output of c (print, messages) goes to out(arg, s, n),
+ * at the end of each cs_eval; stdout if out is NULL */
+void cs_output(Cs *c, void (*out)(void *arg, const char *s, size_t n), void *arg);
+
+/* evaluates the lines of text (separated by newlines) in turn,
+ * until one fails; a failed line leaves c usable */
+cs_rc cs_eval(Cs *c, const char *text);
+
+/* symbols of c's root environment, "it" for the last value */
+cs_kind cs_kind_of(Cs *c, const char *name);
+bool cs_nat(Cs *c, const char *name, long long *v);
+bool cs_real(Cs *c, const char *name, double *v);	/* naturals converted */
+/* the numbers of a list, at most n in v,
+ * returns its length, 0 if not a list of numbers */
+size_t cs_reals(Cs *c, const char *name, double *v, size_t n);
+/* as print shows it, fresh, NULL if undefined */
+char *cs_text(Cs *c, const char *name);
+
+#endif
@@ -19,13 +19,18 @@
  *
  * 13.10.2022 created.
  *
- * gcc -std=gnu99 -Wall -g -I./libgrapheme/include -L./libgrapheme/lib this_file -lgrapheme 
+ * gcc -std=gnu99 -Wall -g -pthread -I./libgrapheme/include -L./libgrapheme/lib this_file -lgrapheme 
+ *
+ * as a library (see codespeak.h): 
+ * gcc -std=gnu99 -Wall -g -pthread -I./libgrapheme/include -DCODESPEAK_LIB -c this_file 
+ * ar rcs libcodespeak.a phrase.o
  *
  */
 
 #include <grapheme.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -33,8 +38,39 @@
 #include <errno.h>
 #include <limits.h>
 #include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "codespeak.h"
+
+static unsigned Trace = 0;	/* categories of events recorded, see evcat */
+/* limits of new contexts, see Limits */
+static size_t Fuel = 0;	/* steps allowed per phrase, 0 for no limit */
+static long Timeout = 0;	/* milliseconds allowed per phrase, 0 for no limit */
+
+/* of the context evaluating in this thread */
+static __thread bool Dbg;	/* reports of the parser, --opt and --jit */
+static __thread bool Jit;	/* compile hot numeric functions */
+static __thread bool Opt;	/* optimize function bodies when defined */
+static __thread FILE *Outf;	/* output, stdout if NULL */
 
-bool Dbg = false;
+static int outf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static int
+outf(const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	int r = vfprintf(Outf != NULL ? Outf : stdout, fmt, ap);
+	va_end(ap);
+	return r;
+}
 
 /* ----- words to evaluate --------- */
 
@@ -81,7 +117,7 @@ word(wtype a) {
 static Word *
 word_str(char *a, size_t n) {
 	if (n >= WSZ) {
-		printf("? %s: word to big\n", 
+		outf("? %s: word to big\n", 
 				__FUNCTION__);
 		return NULL;
 	}
@@ -159,7 +195,7 @@ exp_of_words(char *a) {
 			continue;
 		} 
 		if (boff+read >= WSZ) {
-			printf("\n? %s: word too big (%luB)!\n", 
+			outf("\n? %s: word too big (%luB)!\n", 
 					__FUNCTION__,
 					boff+read);
 			free_x(b);
@@ -179,7 +215,7 @@ exp_of_words(char *a) {
 
 /* ----- From words to semes (increased semantics) ----- */
 
-typedef enum {SNIL, SNAT, SREA, SSYM, SLST, SSEQ} stype;
+typedef enum {SNIL, SNAT, SREA, SSYM, SLST, SSEQ, SBIG} stype;
 
 typedef union Sem_ Sem;
 
@@ -204,6 +240,10 @@ typedef union Sem_ {
 		stype t;
 		char v[WSZ];
 	} sym;
+	struct {
+		stype t;
+		char v[WSZ];	/* decimal digits */
+	} big;
 	struct {
 		stype t;
 		List v;
@@ -219,33 +259,36 @@ print_s(Sem *a) {
 	assert(a != NULL);
 	switch (a->hdr.t) {
 		case SNIL:
-			printf("Nil ");
+			outf("Nil ");
 			break;
 		case SNAT:
-			printf("%lldN ", a->nat.v);
+			outf("%lldN ", a->nat.v);
 			break;
 		case SREA:
-			printf("%.2lfR ", a->rea.v);
+			outf("%.2lfR ", a->rea.v);
 			break;
 		case SSYM:
-			printf("%s ", a->sym.v);
+			outf("%s ", a->sym.v);
+			break;
+		case SBIG:
+			outf("%sN ", a->big.v);
 			break;
 		case SLST:
-			printf("{ ");
+			outf("{ ");
 			for (size_t i=0; i<a->lst.v.n; ++i) {
 				print_s(a->lst.v.s+i);
 			}
-			printf("} ");
+			outf("} ");
 			break;
 		case SSEQ:
-			printf("( ");
+			outf("( ");
 			for (size_t i=0; i<a->seq.v.n; ++i) {
 				print_s(a->seq.v.s+i);
 			}
-			printf(") ");
+			outf(") ");
 			break;
 		default:
-			printf("? %s: unknown seme\n",
+			outf("? %s: unknown seme\n",
 					__FUNCTION__);
 	}
 }
@@ -304,6 +347,7 @@ free_s(Sem *a) {
 		case SNAT:
 		case SREA:
 		case SSYM:
+		case SBIG:
 			break;
 		case SSEQ:
 			for (size_t i=0; i<a->seq.v.n; ++i) {
@@ -318,7 +362,7 @@ free_s(Sem *a) {
 			free(a->lst.v.s);
 			break;
 		default:
-			printf("? %s: unknown seme\n",
+			outf("? %s: unknown seme\n",
 					__FUNCTION__);
 	}
 }
@@ -326,7 +370,7 @@ free_s(Sem *a) {
 static Sem* 
 isnat(Word *a) {
 	if (a->t != STR) {
-		printf("? %s word is not a string\n",
+		outf("? %s word is not a string\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -334,25 +378,26 @@ isnat(Word *a) {
 	char *end = NULL;
 	long long n = strtoll(a->v, &end, 10);
 	if (errno == EINVAL) {
-		printf("? %s: natural number invalid %s\n", 
+		outf("? %s: natural number invalid %s\n", 
 				__FUNCTION__, a->v);
 		return NULL;
 	}
-	if (errno == ERANGE) {
-		printf("? %s: natural number out of range %s\n", 
-				__FUNCTION__, a->v);
-		return NULL;
-	} 
 	if (*end != '\0') {
 		return NULL;
 	} 
+	if (errno == ERANGE) {
+		/* too large for long long: big natural */
+		Sem *b = sem_sym(a->v);
+		b->big.t = SBIG;
+		return b;
+	} 
 	return sem_nat(n);
 }
 
 static Sem *
 isrea(Word *a) {
 	if (a->t != STR) {
-		printf("? %s word is not a string\n",
+		outf("? %s word is not a string\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -364,10 +409,10 @@ isrea(Word *a) {
 	}
 	if (errno == ERANGE) {
 		if (f == 0) {
-			printf("? %s: real underflow %s\n", 
+			outf("? %s: real underflow %s\n", 
 					__FUNCTION__, a->v);
 		} else {
-			printf("? %s: real overflow %s\n", 
+			outf("? %s: real overflow %s\n", 
 					__FUNCTION__, a->v);
 		}
 	}
@@ -377,7 +422,7 @@ isrea(Word *a) {
 static Sem *
 issym(Word *a) {
 	if (a->t != STR) {
-		printf("? %s: word is not a string\n",
+		outf("? %s: word is not a string\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -389,7 +434,7 @@ push_s(Sem *a, Sem *b) {
 	assert(a != NULL && "seq or lst is null");
 	assert(b != NULL && "pushed seme is null");
 	if (a->hdr.t != SSEQ && a->hdr.t != SLST) {
-		printf("? %s: not a seq or lst seme\n",
+		outf("? %s: not a seq or lst seme\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -407,14 +452,14 @@ static Sem *
 lst_of(Sem *a) {
 	assert(a != NULL);
 	if (a->hdr.t != SSEQ && a->hdr.t != SLST) {
-		printf("? %s: not a seq or lst seme\n",
+		outf("? %s: not a seq or lst seme\n",
 				__FUNCTION__);
 		free_s(a);
 		free(a);
 		return NULL;
 	}
 	if (a->hdr.t == SSEQ && a->seq.v.n > 1) {
-		printf("? %s: cannot add a list element to a seq-seme\n",
+		outf("? %s: cannot add a list element to a seq-seme\n",
 				__FUNCTION__);
 		free_s(a);
 		free(a);
@@ -452,7 +497,7 @@ seme_of_exp_part(Expr *a, size_t from, size_t tox) {
 				break;
 			case LEFT:
 				if (b->hdr.t == SLST && !lst_expect1) {
-					printf("? %s: unexpected list element\n",
+					outf("? %s: unexpected list element\n",
 							__FUNCTION__);
 					free_s(b);
 					free(b);
@@ -482,7 +527,7 @@ seme_of_exp_part(Expr *a, size_t from, size_t tox) {
 					}
 				}
 				if (inpar != 0) {
-					printf("? %s: unmatched %s\n",
+					outf("? %s: unmatched %s\n",
 							__FUNCTION__,
 							inpar < 0 ? ")" : "(");
 					free_s(b);
@@ -491,14 +536,14 @@ seme_of_exp_part(Expr *a, size_t from, size_t tox) {
 				}
 				break;
 			case RIGHT:
-				printf("? %s: unmatched )\n",
+				outf("? %s: unmatched )\n",
 						__FUNCTION__);
 				free_s(b);
 				free(b);
 				return NULL;
 			case STR:
 				if (b->hdr.t == SLST && !lst_expect1) {
-					printf("? %s: unexpected list element\n",
+					outf("? %s: unexpected list element\n",
 							__FUNCTION__);
 					free_s(b);
 					free(b);
@@ -512,7 +557,7 @@ seme_of_exp_part(Expr *a, size_t from, size_t tox) {
 					c = issym(a->w+iw);
 				}
 				if (c == NULL) {
-					printf("? %s: unknown word\n",
+					outf("? %s: unknown word\n",
 							__FUNCTION__);
 					free_s(b);
 					free(b);
@@ -526,7 +571,7 @@ seme_of_exp_part(Expr *a, size_t from, size_t tox) {
 				pushed = true;
 				break;
 			default:
-				printf("? %s: unexpected word\n",
+				outf("? %s: unexpected word\n",
 						__FUNCTION__);
 				free_s(b);
 				free(b);
@@ -552,7 +597,7 @@ seme_of_exp(Expr *a) {
 
 /* ----- Evaluation, pass 1 ----- */
 
-typedef enum {VNIL, VNAT, VREA, VOPE, VFUN, VSYM, VLST, VSEQ} vtype;
+typedef enum {VNIL, VNAT, VREA, VOPE, VFUN, VSYM, VLST, VSEQ, VARR, VBIG, VVEC, VGEN} vtype;
 
 typedef union Val_ Val;
 
@@ -595,13 +640,25 @@ typedef enum {
 typedef struct {
 	char name[WSZ];
 	Val *v;
+	size_t refs;	/* > 1: held by frames too, then read only */
 } Symval;
 
+/* symbols a function captured when defined: immutable once shared, 
+ * shared by the function's copies and the envs running it */
+typedef struct {
+	size_t refs;
+	size_t n;
+	Symval **s;
+} Frame;
+
 typedef struct Env_ {
 	istate state;
 	size_t n;
 	Symval **s;
+	size_t loops;	/* loops running in this env */
+	Frame *cap;	/* of the function running in this env, or NULL */
 	struct Env_ *parent;
+	uint64_t id;	/* unique, for the symbol caches */
 } Env;
 
 typedef struct {
@@ -609,116 +666,734 @@ typedef struct {
 	Val *v;
 } Ires;		/* return type for reduce */
 
+/* packed numbers (all VNAT or all VREA), immutable, shared by copies */
+typedef struct {
+	size_t refs;
+	vtype t;
+	size_t n;
+	union {
+		long long *nat;
+		double *rea;
+	} v;
+	uint64_t h;	/* structural hash, 0 until computed */
+	void *map;	/* if v is a file mapped (load-array), else NULL */
+	size_t len;
+} Arr;
+
+/* numeric list literals from that size on are packed */
+#define PACKMIN 4
+
+/* lazy sequence: n elements made on demand, from+i for a range, 
+ * f applied to i for a generator; immutable, shared by copies */
+typedef struct {
+	size_t refs;
+	long long from;
+	size_t n;
+	Val *f;	/* NULL for a range */
+} Gen;
+
+/* ranges from that size on are lazy */
+#define LAZYMIN 1024
+/* elements of a lazy sequence printed */
+#define LAZYPRINT 10
+
+/* natural past long long: sign and magnitude in base 2^32 limbs, 
+ * least significant first, immutable, shared by copies */
+typedef struct {
+	size_t refs;
+	bool neg;
+	size_t n;
+	uint32_t *d;
+} Big;
+
+/* persistent vector node: a leaf holds one element (v), 
+ * an inner node (v NULL) both children l and r */
+typedef struct Vnode_ {
+	size_t refs;
+	size_t n;	/* elements */
+	int ht;	/* height, leaves are 1 */
+	uint64_t h;	/* structural hash, 0 until computed */
+	struct Vnode_ *l, *r;
+	Val *v;
+} Vnode;
+
+/* lent: an atom (VNIL, VNAT, VREA, VOPE, VSYM) of a stored line, 
+ * lent by its Code to the sequence the line is reduced over, 
+ * not freed with it (see held_line); false for any other value */
 typedef union Val_ {
 	struct {
 		vtype t;
+		bool lent;
 	} hdr;
 	struct {
 		vtype t;
+		bool lent;
 		long long v;
 	} nat;
 	struct {
 		vtype t;
+		bool lent;
 		double v;
 	} rea;
 	struct {
 		vtype t;
+		bool lent;
 		int prio;
 		Ires (*v)(Env *e, Val *s, size_t p);
 		int arity;
 		char name[WSZ];
+		size_t site;	/* in a stored body: its type feedback, else 0 */
 	} symop;
 	struct {
 		vtype t;
 		List_v param;
 		List_v body;
+		Frame *cap;
+		struct Code_ *code;	/* of body, NULL until run */
 		char name[WSZ];
 	} symf;
 	struct {
 		stype t;
+		bool lent;
 		char v[WSZ];
+		size_t site;	/* in a stored body: its cache entry, else 0 */
 	} sym;
 	struct {
 		vtype t;
 		List_v v;
+		uint64_t h;	/* structural hash, 0 until computed */
 	} lst;
 	struct {
 		vtype t;
 		List_v v;
+		uint64_t h;	/* unused, sequences are reduced in place */
 	} seq;
+	struct {
+		vtype t;
+		Arr *v;
+	} arr;
+	struct {
+		vtype t;
+		Big *v;
+	} big;
+	struct {
+		vtype t;
+		Vnode *v;	/* NULL if empty */
+	} vec;
+	struct {
+		vtype t;
+		Gen *v;
+	} gen;
 } Val;
 
+/* control flow of a function body, built when first run, 
+ * then immutable and shared by the function's copies: 
+ * for an `if or `else line, the line its skip ends at (n if none), 
+ * for a `loop line, its `end `loop line and the loop collected; 
+ * 0 and NULL for other lines. Lines of common idioms are fused. */
+typedef enum {
+	FNONE,
+	FSTORE,	/* a op b ; call it x */
+	FIF	/* if a cmp b */
+} fuse;
+
+typedef struct Code_ {
+	size_t refs;
+	size_t n;
+	size_t *to;
+	Val **loop;
+	unsigned char *fuse;	/* of each line */
+	Val **held;	/* of each line, its atoms, lent to the lines reduced */
+	size_t *nheld;
+	size_t calls;	/* before the function gets compiled */
+	struct Jitfn_ *jit;	/* compiled, per argument types */
+} Code;
+
+/* what native code may take, updated by it as it runs */
+typedef struct {
+	uintptr_t floor;	/* stack it may not go below */
+	int64_t ticks;	/* calls left before the limits are checked */
+	int64_t depth;	/* calls it may still nest */
+} Jctl;
+
+/* native code of a function, for one set of argument types */
+typedef struct Jitfn_ {
+	unsigned sig;	/* bit i set if argument i is real */
+	int (*fn)(int64_t *args, int64_t *out, Jctl *ctl);	/* NULL if not compilable */
+	vtype ret;
+	void *map;
+	size_t len;
+	struct Jitfn_ *next;
+} Jitfn;
+
+/* ----- big naturals: arbitrary precision, past long long ----- 
+ * magnitudes are arrays of base 2^32 limbs, least significant first,
+ * the mag_* functions accept leading zero limbs.
+ * Values fitting a long long are always VNAT, never VBIG.
+ */
+
+/* Karatsuba multiplication from that many limbs on */
+#define KARAMIN 32
+
+static size_t
+mag_trim(const uint32_t *a, size_t n) {
+	while (n > 0 && a[n-1] == 0) {
+		--n;
+	}
+	return n;
+}
+static int
+mag_cmp(const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+	an = mag_trim(a, an);
+	bn = mag_trim(b, bn);
+	if (an != bn) {
+		return an < bn ? -1 : 1;
+	}
+	for (size_t i=an; i>0; --i) {
+		if (a[i-1] != b[i-1]) {
+			return a[i-1] < b[i-1] ? -1 : 1;
+		}
+	}
+	return 0;
+}
+static uint32_t
+mag_addto(uint32_t *r, size_t rn, const uint32_t *b, size_t bn) {
+	/* r += b, bn <= rn, returns the carry out of r */
+	uint64_t c = 0;
+	size_t i = 0;
+	for (; i<bn; ++i) {
+		c += (uint64_t)r[i] + b[i];
+		r[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	for (; c && i<rn; ++i) {
+		c += r[i];
+		r[i] = (uint32_t)c;
+		c >>= 32;
+	}
+	return (uint32_t)c;
+}
+static void
+mag_subfrom(uint32_t *r, size_t rn, const uint32_t *b, size_t bn) {
+	/* r -= b, r >= b */
+	int64_t c = 0;
+	size_t i = 0;
+	bn = mag_trim(b, bn);
+	for (; i<bn; ++i) {
+		c += (int64_t)r[i] - b[i];
+		r[i] = (uint32_t)c;
+		c = c < 0 ? -1 : 0;
+	}
+	for (; c && i<rn; ++i) {
+		c += r[i];
+		r[i] = (uint32_t)c;
+		c = c < 0 ? -1 : 0;
+	}
+}
+static void
+mag_mul_school(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *r) {
+	/* r[an+bn] = a * b */
+	memset(r, 0, (an+bn) * sizeof(*r));
+	for (size_t i=0; i<an; ++i) {
+		uint64_t c = 0;
+		for (size_t j=0; j<bn; ++j) {
+			c += (uint64_t)a[i] * b[j] + r[i+j];
+			r[i+j] = (uint32_t)c;
+			c >>= 32;
+		}
+		r[i+bn] = (uint32_t)c;
+	}
+}
+static void
+mag_mul(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *r) {
+	/* r[an+bn] = a * b, Karatsuba for large operands */
+	if (an < bn) {
+		const uint32_t *t = a; a = b; b = t;
+		size_t tn = an; an = bn; bn = tn;
+	}
+	if (bn < KARAMIN) {
+		mag_mul_school(a, an, b, bn, r);
+		return;
+	}
+	memset(r, 0, (an+bn) * sizeof(*r));
+	if (2*bn <= an) {
+		/* unbalanced: a in slices of b's size */
+		uint32_t *t = malloc(2*bn * sizeof(*t));
+		assert(t != NULL);
+		for (size_t i=0; i<an; i+=bn) {
+			size_t k = an-i < bn ? an-i : bn;
+			mag_mul(a+i, k, b, bn, t);
+			mag_addto(r+i, an+bn-i, t, k+bn);
+		}
+		free(t);
+		return;
+	}
+	/* a = a1.B^m + a0, b = b1.B^m + b0, 
+	 * a.b = z2.B^2m + (z1 - z2 - z0).B^m + z0 with z1 = (a1+a0)(b1+b0) */
+	size_t m = an / 2;
+	size_t a1n = an - m;
+	size_t b1n = bn - m;
+	size_t sn = a1n + 1; /* a1n >= m, b1n */
+	uint32_t *sa = calloc(sn, sizeof(*sa));
+	uint32_t *sb = calloc(sn, sizeof(*sb));
+	uint32_t *z1 = malloc(2*sn * sizeof(*z1));
+	assert(sa != NULL && sb != NULL && z1 != NULL);
+	memcpy(sa, a+m, a1n * sizeof(*sa));
+	mag_addto(sa, sn, a, m);
+	memcpy(sb, b+m, b1n * sizeof(*sb));
+	mag_addto(sb, sn, b, m);
+	mag_mul(sa, sn, sb, sn, z1);
+	/* z0 and z2 straight into r */
+	mag_mul(a, m, b, m, r);
+	mag_mul(a+m, a1n, b+m, b1n, r+2*m);
+	mag_subfrom(z1, 2*sn, r, 2*m);
+	mag_subfrom(z1, 2*sn, r+2*m, a1n+b1n);
+	mag_addto(r+m, an+bn-m, z1, mag_trim(z1, 2*sn));
+	free(sa);
+	free(sb);
+	free(z1);
+}
+static uint32_t
+mag_divsmall(uint32_t *a, size_t an, uint32_t d) {
+	/* a /= d in place, returns remainder */
+	uint64_t r = 0;
+	for (size_t i=an; i>0; --i) {
+		r = (r << 32) | a[i-1];
+		a[i-1] = (uint32_t)(r / d);
+		r %= d;
+	}
+	return (uint32_t)r;
+}
+static void
+mag_div(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *q) {
+	/* q[an] = a / b, b trimmed and not 0 (Knuth, algorithm D) */
+	memset(q, 0, an * sizeof(*q));
+	if (mag_cmp(a, an, b, bn) < 0) {
+		return;
+	}
+	if (bn == 1) {
+		memcpy(q, a, an * sizeof(*q));
+		mag_divsmall(q, an, b[0]);
+		return;
+	}
+	/* normalize: divisor's top bit set */
+	int sh = __builtin_clz(b[bn-1]);
+	uint32_t *u = calloc(an+1, sizeof(*u));
+	uint32_t *v = malloc(bn * sizeof(*v));
+	assert(u != NULL && v != NULL);
+	for (size_t i=bn; i>0; --i) {
+		v[i-1] = (b[i-1] << sh) 
+			| (sh && i > 1 ? b[i-2] >> (32-sh) : 0);
+	}
+	u[an] = sh ? a[an-1] >> (32-sh) : 0;
+	for (size_t i=an; i>0; --i) {
+		u[i-1] = (a[i-1] << sh) 
+			| (sh && i > 1 ? a[i-2] >> (32-sh) : 0);
+	}
+	for (size_t j=an-bn+1; j>0; --j) {
+		size_t k = j-1;
+		uint64_t num = ((uint64_t)u[k+bn] << 32) | u[k+bn-1];
+		uint64_t qh = num / v[bn-1];
+		uint64_t rh = num % v[bn-1];
+		while (qh >> 32 
+				|| qh * v[bn-2] > ((rh << 32) | u[k+bn-2])) {
+			--qh;
+			rh += v[bn-1];
+			if (rh >> 32) {
+				break;
+			}
+		}
+		/* u[k..k+bn] -= qh * v */
+		int64_t br = 0;
+		uint64_t c = 0;
+		for (size_t i=0; i<bn; ++i) {
+			uint64_t p = qh * v[i] + c;
+			c = p >> 32;
+			int64_t t = (int64_t)u[k+i] - (uint32_t)p + br;
+			u[k+i] = (uint32_t)t;
+			br = t >> 32;
+		}
+		int64_t t = (int64_t)u[k+bn] - (int64_t)c + br;
+		u[k+bn] = (uint32_t)t;
+		if (t < 0) {
+			/* qh one too large: add back */
+			--qh;
+			uint64_t cc = 0;
+			for (size_t i=0; i<bn; ++i) {
+				cc += (uint64_t)u[k+i] + v[i];
+				u[k+i] = (uint32_t)cc;
+				cc >>= 32;
+			}
+			u[k+bn] += (uint32_t)cc;
+		}
+		q[k] = (uint32_t)qh;
+	}
+	free(u);
+	free(v);
+}
+
+/* signed operand, borrowed from a VNAT or VBIG */
+typedef struct {
+	bool neg;
+	size_t n;
+	const uint32_t *d;
+	uint32_t w[2];	/* VNAT limbs */
+} Bigv;
+
+static void
+bigv_of(Val *a, Bigv *b) {
+	/* b must not be moved while in use */
+	if (a->hdr.t == VBIG) {
+		b->neg = a->big.v->neg;
+		b->n = a->big.v->n;
+		b->d = a->big.v->d;
+		return;
+	}
+	long long x = a->nat.v;
+	unsigned long long m = x < 0 ? -(unsigned long long)x : (unsigned long long)x;
+	b->neg = x < 0;
+	b->w[0] = (uint32_t)m;
+	b->w[1] = (uint32_t)(m >> 32);
+	b->d = b->w;
+	b->n = mag_trim(b->w, 2);
+}
+static Val *
+val_of_mag(bool neg, uint32_t *d, size_t n) {
+	/* fresh VNAT if it fits, else VBIG stealing d */
+	n = mag_trim(d, n);
+	Val *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	if (n <= 2) {
+		unsigned long long m = n == 0 ? 0 
+			: (n == 1 ? d[0] : ((unsigned long long)d[1] << 32) | d[0]);
+		if (m <= (unsigned long long)LLONG_MAX 
+				|| (neg && m == (unsigned long long)LLONG_MAX + 1)) {
+			a->hdr.t = VNAT;
+			a->hdr.lent = false;
+			a->nat.v = neg ? (long long)(0 - m) : (long long)m;
+			free(d);
+			return a;
+		}
+	}
+	Big *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->refs = 1;
+	b->neg = neg;
+	b->n = n;
+	b->d = d;
+	a->hdr.t = VBIG;
+	a->big.v = b;
+	return a;
+}
+static Val *
+big_add(Bigv *a, Bigv *b, bool bneg) {
+	/* a + b, with b's sign bneg */
+	size_t n = (a->n > b->n ? a->n : b->n) + 1;
+	uint32_t *r = calloc(n, sizeof(*r));
+	assert(r != NULL);
+	if (a->neg == bneg) {
+		memcpy(r, a->d, a->n * sizeof(*r));
+		mag_addto(r, n, b->d, b->n);
+		return val_of_mag(a->neg, r, n);
+	}
+	if (mag_cmp(a->d, a->n, b->d, b->n) >= 0) {
+		memcpy(r, a->d, a->n * sizeof(*r));
+		mag_subfrom(r, n, b->d, b->n);
+		return val_of_mag(a->neg, r, n);
+	}
+	memcpy(r, b->d, b->n * sizeof(*r));
+	mag_subfrom(r, n, a->d, a->n);
+	return val_of_mag(bneg, r, n);
+}
+static Val *
+big_mul(Bigv *a, Bigv *b) {
+	size_t n = a->n + b->n;
+	uint32_t *r = calloc(n > 0 ? n : 1, sizeof(*r));
+	assert(r != NULL);
+	if (a->n > 0 && b->n > 0) {
+		mag_mul(a->d, a->n, b->d, b->n, r);
+	}
+	return val_of_mag(a->neg != b->neg, r, n);
+}
+static Val *
+big_div(Bigv *a, Bigv *b) {
+	/* truncated, like long long division; b is not 0 */
+	uint32_t *q = calloc(a->n > 0 ? a->n : 1, sizeof(*q));
+	assert(q != NULL);
+	if (a->n > 0) {
+		mag_div(a->d, a->n, b->d, b->n, q);
+	}
+	return val_of_mag(a->neg != b->neg, q, a->n);
+}
+static int
+big_cmp(Bigv *a, Bigv *b) {
+	bool az = a->n == 0;
+	bool bz = b->n == 0;
+	if (a->neg != b->neg && !(az && bz)) {
+		return a->neg ? -1 : 1;
+	}
+	int c = mag_cmp(a->d, a->n, b->d, b->n);
+	return a->neg ? -c : c;
+}
+static double
+dbl_of_big(Big *a) {
+	double r = 0.;
+	for (size_t i=a->n; i>0; --i) {
+		r = r * 4294967296. + a->d[i-1];
+	}
+	return a->neg ? -r : r;
+}
+static Val *
+big_of_str(const char *a) {
+	/* decimal digits, with an optional sign */
+	bool neg = false;
+	if (*a == '-' || *a == '+') {
+		neg = *a == '-';
+		++a;
+	}
+	size_t len = strlen(a);
+	size_t n = len / 9 + 2;
+	uint32_t *d = calloc(n, sizeof(*d));
+	assert(d != NULL);
+	for (size_t i=0; i<len; ) {
+		/* d = d * 10^k + next k digits */
+		uint32_t chunk = 0;
+		uint32_t mul = 1;
+		for (size_t k=0; k<9 && i<len; ++k, ++i) {
+			chunk = chunk * 10 + (a[i] - '0');
+			mul *= 10;
+		}
+		uint64_t c = chunk;
+		for (size_t j=0; j<n; ++j) {
+			c += (uint64_t)d[j] * mul;
+			d[j] = (uint32_t)c;
+			c >>= 32;
+		}
+	}
+	return val_of_mag(neg, d, n);
+}
+static void
+print_big(Big *a) {
+	/* decimal, in chunks of 9 digits */
+	uint32_t *t = malloc(a->n * sizeof(*t));
+	size_t nc = a->n * 10 / 9 + 2;
+	uint32_t *c = malloc(nc * sizeof(*c));
+	assert(t != NULL && c != NULL);
+	memcpy(t, a->d, a->n * sizeof(*t));
+	size_t n = a->n;
+	size_t k = 0;
+	while (n > 0) {
+		c[k++] = mag_divsmall(t, n, 1000000000);
+		n = mag_trim(t, n);
+	}
+	outf("%s%u", a->neg ? "-" : "", k > 0 ? c[k-1] : 0);
+	for (size_t i=k > 0 ? k-1 : 0; i>0; --i) {
+		outf("%09u", c[i-1]);
+	}
+	outf(" ");
+	free(t);
+	free(c);
+}
+
+/* ----- persistent vectors: AVL trees of elements, nodes immutable and
+ * shared between the versions of a vector (append, set, ... build new
+ * paths only), so older versions stay valid ----- */
+
+static void free_v(Val *a);
+static void printx_v(Val *a, bool abr, const char *pfx);
+static Val *copy_v(Val *a);
+
+static Vnode *
+vn_ref(Vnode *a) {
+	if (a != NULL) {
+		__atomic_add_fetch(&a->refs, 1, __ATOMIC_RELAXED);
+	}
+	return a;
+}
+static void
+vn_free(Vnode *a) {
+	while (a != NULL) {
+		if (__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+			return;
+		}
+		Vnode *r = a->r;
+		free_v(a->v);
+		vn_free(a->l);
+		free(a);
+		a = r; /* no recursion on the right spine */
+	}
+}
+static size_t
+vn_len(Vnode *a) {
+	return a != NULL ? a->n : 0;
+}
+static Val *
+vn_at(Vnode *a, size_t i) {
+	/* i < a->n */
+	while (a->v == NULL) {
+		if (i < a->l->n) {
+			a = a->l;
+		} else {
+			i -= a->l->n;
+			a = a->r;
+		}
+	}
+	return a->v;
+}
+static void
+vn_print(Vnode *a, bool abr, const char *pfx) {
+	if (a == NULL) {
+		return;
+	}
+	if (a->v != NULL) {
+		printx_v(a->v, abr, pfx);
+		return;
+	}
+	vn_print(a->l, abr, pfx);
+	vn_print(a->r, abr, pfx);
+}
+static Val **
+vn_fill(Vnode *a, Val **out) {
+	/* copies of a's elements in out, in order, returns end of out */
+	if (a == NULL) {
+		return out;
+	}
+	if (a->v != NULL) {
+		*out = copy_v(a->v);
+		return out + 1;
+	}
+	out = vn_fill(a->l, out);
+	return vn_fill(a->r, out);
+}
+
 static void print_v(Val *a, bool abr);
 
 static void
 printx_v(Val *a, bool abr, const char *pfx) {
 	if (a == NULL) {
-		printf("\n? %s: NULL\n", __FUNCTION__);
+		outf("\n? %s: NULL\n", __FUNCTION__);
 		return;
 	}
 	switch (a->hdr.t) {
 		case VNIL:
-			printf("Nil ");
+			outf("Nil ");
 			break;
 		case VNAT:
-			printf("%lld ", a->nat.v);
+			outf("%lld ", a->nat.v);
 			break;
 		case VREA:
-			printf("%.2lf ", a->rea.v);
+			outf("%.2lf ", a->rea.v);
+			break;
+		case VBIG:
+			print_big(a->big.v);
 			break;
 		case VOPE:
-			printf("`%s ", a->symop.name);
+			outf("`%s ", a->symop.name);
 			break;
 		case VFUN:
 			if (abr) {
-				printf("%s`%s ", pfx, a->symf.name);
+				outf("%s`%s ", pfx, a->symf.name);
 				break;
 			}
-			printf("\n%s `%s (", pfx, a->symf.name);
+			outf("\n%s `%s (", pfx, a->symf.name);
 			for (size_t i=0; i<a->symf.param.n; ++i) {
 				print_v(a->symf.param.v[i], abr);
 			}
-			printf(") [%lu]:", a->symf.body.n);
+			outf(") [%lu]", a->symf.body.n);
+			if (a->symf.cap != NULL) {
+				outf(" < ");
+				for (size_t i=0; i<a->symf.cap->n; ++i) {
+					outf("'%s ", a->symf.cap->s[i]->name);
+					print_v(a->symf.cap->s[i]->v, true);
+				}
+				outf(">");
+			}
+			outf(":");
 			for (size_t i=0; i<a->symf.body.n; ++i) {
 				size_t N = 2;
 				if (i > N && i < a->symf.body.n - N) {
 					if (i == N+1) {
-						printf("\n%s    ", pfx);
+						outf("\n%s    ", pfx);
 					}
-					printf(".");
+					outf(".");
 				} else {
-					printf("\n%s    ", pfx);
+					outf("\n%s    ", pfx);
 					print_v(a->symf.body.v[i], abr);
 				}
 			}
 			break;
 		case VSYM:
-			printf("'%s ", a->sym.v);
+			outf("'%s ", a->sym.v);
 			break;
 		case VLST:
 			if (abr) {
-				printf("%s{ x%lu } ", pfx, a->lst.v.n);
+				outf("%s{ x%lu } ", pfx, a->lst.v.n);
 				break;
 			}
-			printf("%s{ ", pfx);
+			outf("%s{ ", pfx);
 			for (size_t i=0; i<a->lst.v.n; ++i) {
 				printx_v(a->lst.v.v[i], abr, pfx);
 			}
-			printf("} ");
+			outf("} ");
 			break;
 		case VSEQ:
 			if (abr) {
-				printf("%s( x%lu ) ", pfx, a->seq.v.n);
+				outf("%s( x%lu ) ", pfx, a->seq.v.n);
 				break;
 			}
-			printf("%s( ", pfx);
+			outf("%s( ", pfx);
 			for (size_t i=0; i<a->seq.v.n; ++i) {
 				printx_v(a->seq.v.v[i], abr, pfx);
 			}
-			printf(") ");
+			outf(") ");
+			break;
+		case VVEC:
+			if (abr) {
+				outf("%s{ x%lu } ", pfx, vn_len(a->vec.v));
+				break;
+			}
+			outf("%s{ ", pfx);
+			vn_print(a->vec.v, abr, pfx);
+			outf("} ");
+			break;
+		case VARR:
+			if (abr) {
+				outf("%s{ x%lu } ", pfx, a->arr.v->n);
+				break;
+			}
+			outf("%s{ ", pfx);
+			for (size_t i=0; i<a->arr.v->n; ++i) {
+				if (a->arr.v->t == VNAT) {
+					outf("%lld ", a->arr.v->v.nat[i]);
+				} else {
+					outf("%.2lf ", a->arr.v->v.rea[i]);
+				}
+			}
+			outf("} ");
+			break;
+		case VGEN:
+			if (a->gen.v->f != NULL) {
+				/* its elements need an env, see print_gen */
+				outf("%s{ %s x%lu } ", pfx, a->gen.v->f->hdr.t == VFUN 
+						? a->gen.v->f->symf.name : a->gen.v->f->symop.name, 
+						a->gen.v->n);
+				break;
+			}
+			if (abr) {
+				outf("%s{ x%lu } ", pfx, a->gen.v->n);
+				break;
+			}
+			outf("%s{ ", pfx);
+			for (size_t i=0; i<a->gen.v->n && i<LAZYPRINT; ++i) {
+				outf("%lld ", a->gen.v->from + (long long)i);
+			}
+			if (a->gen.v->n > LAZYPRINT) {
+				outf(".. x%lu ", a->gen.v->n);
+			}
+			outf("} ");
 			break;
 		default:
-			printf("? %s: unknown value\n",
+			outf("? %s: unknown value\n",
 					__FUNCTION__);
 	}
 }
@@ -730,28 +1405,28 @@ static void
 print_istate(istate s) {
 	switch (s) {
 		case RUN:
-			printf("Ok ");
+			outf("Ok ");
 			break;
 		case IFSKIP:
-			printf("Skip ");
+			outf("Skip ");
 			break;
 		case FUNDEF:
-			printf("Fun ");
+			outf("Fun ");
 			break;
 		case RETURN:
-			printf("Return ");
+			outf("Return ");
 			break;
 		case LOOPDEF:
-			printf("Loop ");
+			outf("Loop ");
 			break;
 		case STOP:
-			printf("Stop ");
+			outf("Stop ");
 			break;
 		case BACKTRACK:
-			printf("Backtrack ");
+			outf("Backtrack ");
 			break;
 		case FATAL:
-			printf("Fatal ");
+			outf("Fatal ");
 			break;
 	}
 }
@@ -759,47 +1434,131 @@ static void
 print_code(rc s) {
 	switch (s) {
 		case FAIL:
-			printf("Fail ");
+			outf("Fail ");
 			break;
 		case OK:
-			printf("Ok ");
+			outf("Ok ");
 			break;
 		case NOP:
-			printf("Nop ");
+			outf("Nop ");
 			break;
 		case SKIP:
-			printf("Skip ");
+			outf("Skip ");
 			break;
 		case DEF:
-			printf("Def ");
+			outf("Def ");
 			break;
 		case BACK:
-			printf("Back ");
+			outf("Back ");
 			break;
 		case RET:
-			printf("Ret ");
+			outf("Ret ");
 			break;
 		case LOOP:
-			printf("Loop ");
+			outf("Loop ");
 			break;
 		case INT:
-			printf("Int ");
+			outf("Int ");
 			break;
 	}
 }
+
+/* ----- trace: binary events in a ring, dumped at exit (see trace_on) ----- */
+
+typedef enum {
+	EVTRANS = 1,	/* a line in transition: state, items, env */
+	EVSTATE = 2,	/* state changed: from, to, eval code */
+	EVREDUCE = 4,	/* operator or function applied: position, items */
+	EVCALL = 8,	/* user function called: compiled, arguments, env */
+	EVLOOP = 16,	/* loop pass: nesting, pass */
+	EVLINE = 32,	/* line of a stored body run: how, line, to line */
+	EVFORCE = 64	/* lazy sequence made: generated, elements */
+} evcat;
+
+typedef struct {
+	uint64_t ns;	/* since tracing started */
+	uint32_t tid;
+	uint8_t ev;
+	uint8_t a;
+	uint16_t b;
+	uint64_t x;
+	char s[8];	/* name, cut */
+} Trec;
+
+#define TRSZ 65536	/* records kept, a power of 2 */
+#define TRMAGIC "CSTR"
+#define TRVERSION 1
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t size;	/* of a record */
+	uint32_t pad;
+	uint64_t n;
+} Trhdr;
+
+static Trec *Ring;
+static uint64_t Ringat;	/* records written */
+static uint64_t Ring0;
+static uint32_t Tids;
+static __thread uint32_t Tid;
+
+static uint64_t
+now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+static void
+trace_ev(evcat ev, unsigned a, size_t b, uint64_t x, const char *name) {
+	/* record an event, over the oldest one once the ring is full */
+	if (Tid == 0) {
+		Tid = __atomic_add_fetch(&Tids, 1, __ATOMIC_RELAXED);
+	}
+	uint64_t k = __atomic_fetch_add(&Ringat, 1, __ATOMIC_RELAXED);
+	Trec *r = Ring + (k & (TRSZ-1));
+	r->ns = now_ns() - Ring0;
+	r->tid = Tid;
+	r->ev = ev;
+	r->a = a;
+	r->b = b > UINT16_MAX ? UINT16_MAX : b;
+	r->x = x;
+	strncpy(r->s, name != NULL ? name : "", sizeof(r->s));
+}
 static void
 print_rc(Ires a) {
-	printf("[");
+	outf("[");
 	print_code(a.code);
-	printf(", ");
+	outf(", ");
 	if (a.v != NULL) {
 		print_v(a.v, false);
 	} else {
-		printf("null");
+		outf("null");
 	}
-	printf(" ]");
+	outf(" ]");
 }
 
+static void free_frame(Frame *a);
+static void free_symval(Symval *a);
+static void free_code(Code *a);
+
+static bool
+isplain_v(Val *a) {
+	/* values without anything of their own to free */
+	vtype t = a->hdr.t;
+	return t == VNIL || t == VNAT || t == VREA || t == VSYM || t == VOPE;
+}
+static bool
+islent_v(Val *a) {
+	return isplain_v(a) && a->hdr.lent;
+}
+static void
+drop_v(Val *a) {
+	/* an item its sequence consumed: freed, unless lent */
+	if (a != NULL && !islent_v(a)) {
+		free_v(a);
+	}
+}
 static void 
 free_v(Val *a) {
 	if (a == NULL) {
@@ -821,10 +1580,12 @@ free_v(Val *a) {
 				free_v(a->symf.body.v[i]);
 			}
 			free(a->symf.body.v);
+			free_frame(a->symf.cap);
+			free_code(a->symf.code);
 			break;
 		case VSEQ:
 			for (size_t i=0; i<a->seq.v.n; ++i) {
-				free_v(a->seq.v.v[i]);
+				drop_v(a->seq.v.v[i]);
 			}
 			free(a->seq.v.v);
 			break;
@@ -834,50 +1595,380 @@ free_v(Val *a) {
 			}
 			free(a->lst.v.v);
 			break;
+		case VARR:
+			/* arrays can be shared by pmap workers */
+			if (__atomic_sub_fetch(&a->arr.v->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+				if (a->arr.v->map != NULL) {
+					munmap(a->arr.v->map, a->arr.v->len);
+				} else {
+					free(a->arr.v->v.nat);
+				}
+				free(a->arr.v);
+			}
+			break;
+		case VVEC:
+			vn_free(a->vec.v);
+			break;
+		case VGEN:
+			if (__atomic_sub_fetch(&a->gen.v->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+				if (a->gen.v->f != NULL) {
+					free_v(a->gen.v->f);
+				}
+				free(a->gen.v);
+			}
+			break;
+		case VBIG:
+			if (__atomic_sub_fetch(&a->big.v->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+				free(a->big.v->d);
+				free(a->big.v);
+			}
+			break;
 		default:
-			printf("? %s: unknown value\n",
+			outf("? %s: unknown value\n",
 					__FUNCTION__);
 	}
 	free(a);
 }
 
-static bool
-istrue_v(Val *a) {
-	assert(a != NULL);
-	if (a->hdr.t == VNIL) {
-		return false;
+static void
+free_frame(Frame *a) {
+	if (a == NULL) {
+		return;
 	}
-	if (a->hdr.t == VNAT) {
-		return a->nat.v != 0;
+	/* frames can be shared by pmap workers */
+	if (__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
 	}
-	if (a->hdr.t == VREA) {
-		return a->rea.v != 0.;
+	for (size_t i=0; i<a->n; ++i) {
+		free_symval(a->s[i]);
 	}
-	if (a->hdr.t == VOPE) {
-		return a->symop.v != NULL;
+	free(a->s);
+	free(a);
+}
+static Frame *
+ref_frame(Frame *a) {
+	if (a != NULL) {
+		__atomic_add_fetch(&a->refs, 1, __ATOMIC_RELAXED);
 	}
-	if (a->hdr.t == VFUN) {
-		return (a->symf.param.n != 0  
-				&& a->symf.body.n != 0);
+	return a;
+}
+static void
+free_code(Code *a) {
+	if (a == NULL) {
+		return;
 	}
-	if (a->hdr.t == VSYM) {
-		return true;
+	if (__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
 	}
-	if (a->hdr.t == VLST) {
-		return a->lst.v.n > 0;
+	for (size_t i=0; i<a->n; ++i) {
+		free_v(a->loop[i]);
+		free(a->held[i]);
+	}
+	free(a->loop);
+	free(a->held);
+	free(a->nheld);
+	free(a->to);
+	free(a->fuse);
+	while (a->jit != NULL) {
+		Jitfn *j = a->jit;
+		a->jit = j->next;
+		if (j->map != NULL) {
+			munmap(j->map, j->len);
+		}
+		free(j);
 	}
-	printf("? %s: unsupported value\n",
-			__FUNCTION__);
-	return false;
+	free(a);
 }
-static bool
-isequal_v(Val *a, Val *b) {
-	assert(a != NULL && b != NULL);
-	if (a->hdr.t != b->hdr.t) {
-		return false;
-	}
-	if (a->hdr.t == VNIL) {
-		return true;
+
+/* --- packed arrays --- */
+
+static Val *
+arr_v(vtype t, size_t n) {
+	/* fresh array of n (uninitialized) numbers of type t */
+	assert(t == VNAT || t == VREA);
+	Arr *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->refs = 1;
+	a->t = t;
+	a->n = n;
+	a->h = 0;
+	a->v.nat = NULL;
+	a->map = NULL;
+	if (n > 0) {
+		if (t == VNAT) {
+			a->v.nat = malloc(n * sizeof(long long));
+		} else {
+			a->v.rea = malloc(n * sizeof(double));
+		}
+		assert(a->v.nat != NULL);
+	}
+	Val *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->hdr.t = VARR;
+	b->arr.v = a;
+	return b;
+}
+static Val *
+gen_v(long long from, size_t n, Val *f) {
+	/* fresh lazy sequence, of f (stolen) if not NULL, else a range */
+	Gen *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->refs = 1;
+	a->from = from;
+	a->n = n;
+	a->f = f;
+	Val *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->hdr.t = VGEN;
+	b->gen.v = a;
+	return b;
+}
+static bool
+islst_v(Val *a) {
+	return a->hdr.t == VLST || a->hdr.t == VARR || a->hdr.t == VVEC;
+}
+static size_t
+len_v(Val *a) {
+	/* a is a list, an array, a vector or lazy */
+	if (a->hdr.t == VARR) {
+		return a->arr.v->n;
+	}
+	if (a->hdr.t == VGEN) {
+		return a->gen.v->n;
+	}
+	if (a->hdr.t == VVEC) {
+		return vn_len(a->vec.v);
+	}
+	return a->lst.v.n;
+}
+static Val *
+elem_v(Val *a, size_t i, Val *tmp) {
+	/* i-th element of a list, array, vector or range, 
+	 * arrays and ranges fill (and return) tmp */
+	if (a->hdr.t == VVEC) {
+		return vn_at(a->vec.v, i);
+	}
+	if (a->hdr.t == VGEN) {
+		assert(a->gen.v->f == NULL);
+		tmp->hdr.t = VNAT;
+		tmp->nat.v = a->gen.v->from + (long long)i;
+		return tmp;
+	}
+	if (a->hdr.t != VARR) {
+		return a->lst.v.v[i];
+	}
+	tmp->hdr.t = a->arr.v->t;
+	if (tmp->hdr.t == VNAT) {
+		tmp->nat.v = a->arr.v->v.nat[i];
+	} else {
+		tmp->rea.v = a->arr.v->v.rea[i];
+	}
+	return tmp;
+}
+
+static bool
+istrue_v(Val *a) {
+	assert(a != NULL);
+	if (a->hdr.t == VNIL) {
+		return false;
+	}
+	if (a->hdr.t == VNAT) {
+		return a->nat.v != 0;
+	}
+	if (a->hdr.t == VREA) {
+		return a->rea.v != 0.;
+	}
+	if (a->hdr.t == VOPE) {
+		return a->symop.v != NULL;
+	}
+	if (a->hdr.t == VFUN) {
+		return (a->symf.param.n != 0  
+				&& a->symf.body.n != 0);
+	}
+	if (a->hdr.t == VSYM) {
+		return true;
+	}
+	if (a->hdr.t == VLST) {
+		return a->lst.v.n > 0;
+	}
+	if (a->hdr.t == VARR) {
+		return a->arr.v->n > 0;
+	}
+	if (a->hdr.t == VVEC) {
+		return a->vec.v != NULL;
+	}
+	if (a->hdr.t == VGEN) {
+		return a->gen.v->n > 0;
+	}
+	if (a->hdr.t == VBIG) {
+		return true;	/* never 0 */
+	}
+	outf("? %s: unsupported value\n",
+			__FUNCTION__);
+	return false;
+}
+static bool isequal_v(Val *a, Val *b);
+static bool isequiv_v(Val *a, Val *b);
+
+/* --- structural hash: equal (and equivalent) values hash the same,
+ * cached in lists and arrays, which are not changed once shared --- */
+
+static uint64_t
+hash_mix(uint64_t h, uint64_t x) {
+	h ^= x;
+	h *= 0x100000001b3ULL;
+	return h ^ (h >> 29);
+}
+static uint64_t
+hash_num(double a) {
+	/* naturals as reals, since 1 ~= 1. */
+	uint64_t x;
+	if (a == 0.) {
+		a = 0.; /* -0. */
+	}
+	memcpy(&x, &a, sizeof(x));
+	return hash_mix(0xcbf29ce484222325ULL, x);
+}
+static uint64_t
+hash_str(const char *a) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; *a != '\0'; ++a) {
+		h = hash_mix(h, (unsigned char)*a);
+	}
+	return h;
+}
+static uint64_t
+hash_v(Val *a) {
+	uint64_t h;
+	switch (a->hdr.t) {
+		case VNAT:
+			return hash_num((double)a->nat.v);
+		case VREA:
+			return hash_num(a->rea.v);
+		case VBIG:
+			return hash_num(dbl_of_big(a->big.v));
+		case VOPE:
+			return hash_mix(VOPE, (uint64_t)(uintptr_t)a->symop.v);
+		case VFUN:
+			/* ~= only compares names */
+			return hash_mix(VFUN, hash_str(a->symf.name));
+		case VSYM:
+			return hash_mix(VSYM, hash_str(a->sym.v));
+		case VLST:
+			h = __atomic_load_n(&a->lst.h, __ATOMIC_RELAXED);
+			if (h != 0) {
+				return h;
+			}
+			h = hash_mix(VLST, a->lst.v.n);
+			for (size_t i=0; i<a->lst.v.n; ++i) {
+				h = hash_mix(h, hash_v(a->lst.v.v[i]));
+			}
+			h += h == 0;
+			__atomic_store_n(&a->lst.h, h, __ATOMIC_RELAXED);
+			return h;
+		case VARR:
+			/* hashes as the list of its numbers */
+			h = __atomic_load_n(&a->arr.v->h, __ATOMIC_RELAXED);
+			if (h != 0) {
+				return h;
+			}
+			h = hash_mix(VLST, a->arr.v->n);
+			for (size_t i=0; i<a->arr.v->n; ++i) {
+				h = hash_mix(h, hash_num(a->arr.v->t == VNAT 
+						? (double)a->arr.v->v.nat[i] : a->arr.v->v.rea[i]));
+			}
+			h += h == 0;
+			__atomic_store_n(&a->arr.v->h, h, __ATOMIC_RELAXED);
+			return h;
+		case VVEC:
+			/* hashes as the list of its elements */
+			if (a->vec.v == NULL) {
+				return hash_mix(VLST, 0);
+			}
+			h = __atomic_load_n(&a->vec.v->h, __ATOMIC_RELAXED);
+			if (h != 0) {
+				return h;
+			}
+			h = hash_mix(VLST, a->vec.v->n);
+			for (size_t i=0; i<a->vec.v->n; ++i) {
+				h = hash_mix(h, hash_v(vn_at(a->vec.v, i)));
+			}
+			h += h == 0;
+			__atomic_store_n(&a->vec.v->h, h, __ATOMIC_RELAXED);
+			return h;
+		case VGEN:
+			/* = only compares how elements are made */
+			h = hash_mix(VGEN, a->gen.v->n);
+			h = hash_mix(h, a->gen.v->n > 0 ? (uint64_t)a->gen.v->from : 0);
+			return a->gen.v->f != NULL ? hash_mix(h, hash_v(a->gen.v->f)) : h;
+		case VSEQ:
+			h = hash_mix(VSEQ, a->seq.v.n);
+			for (size_t i=0; i<a->seq.v.n; ++i) {
+				h = hash_mix(h, hash_v(a->seq.v.v[i]));
+			}
+			return h;
+		default:
+			return hash_mix(a->hdr.t, 0);
+	}
+}
+static bool
+hash_differ(Val *a, Val *b) {
+	/* cheap rejection, for lists and arrays only */
+	return islst_v(a) && islst_v(b) && hash_v(a) != hash_v(b);
+}
+static void
+touch_v(Val *a) {
+	/* a list's items changed: forget its hash */
+	a->lst.h = 0;
+}
+
+static bool
+isequal_frame(Frame *a, Frame *b) {
+	if (a == b) {
+		return true;
+	}
+	size_t an = a != NULL ? a->n : 0;
+	size_t bn = b != NULL ? b->n : 0;
+	if (an != bn) {
+		return false;
+	}
+	for (size_t i=0; i<an; ++i) {
+		if (strncmp(a->s[i]->name, b->s[i]->name, WSZ) != 0
+				|| !isequal_v(a->s[i]->v, b->s[i]->v)) {
+			return false;
+		}
+	}
+	return true;
+}
+static bool
+isequal_arr(Val *a, Val *b, bool (*eq)(Val *, Val *)) {
+	/* at least one of a, b is an array or vector, the other a list, ... */
+	if (len_v(a) != len_v(b)) {
+		return false;
+	}
+	Val x, y;
+	for (size_t i=0; i<len_v(a); ++i) {
+		if (!eq(elem_v(a, i, &x), elem_v(b, i, &y))) {
+			return false;
+		}
+	}
+	return true;
+}
+static bool
+isequal_v(Val *a, Val *b) {
+	assert(a != NULL && b != NULL);
+	if (hash_differ(a, b)) {
+		return false;
+	}
+	if (islst_v(a) && islst_v(b) 
+			&& (a->hdr.t != VLST || b->hdr.t != VLST)) {
+		return isequal_arr(a, b, isequal_v);
+	}
+	if (a->hdr.t != b->hdr.t) {
+		return false;
+	}
+	if (a->hdr.t == VNIL) {
+		return true;
 	}
 	if (a->hdr.t == VNAT) {
 		return (a->nat.v == b->nat.v);
@@ -885,6 +1976,12 @@ isequal_v(Val *a, Val *b) {
 	if (a->hdr.t == VREA) {
 		return (a->rea.v == b->rea.v);
 	}
+	if (a->hdr.t == VBIG) {
+		Bigv x, y;
+		bigv_of(a, &x);
+		bigv_of(b, &y);
+		return big_cmp(&x, &y) == 0;
+	}
 	if (a->hdr.t == VOPE) {
 		return (a->symop.v == b->symop.v);
 	}
@@ -903,12 +2000,15 @@ isequal_v(Val *a, Val *b) {
 				return false;
 			}
 		}
-		return true;
+		return isequal_frame(a->symf.cap, b->symf.cap);
 	}
 	if (a->hdr.t == VSYM) {
 		return (strncmp(a->sym.v, b->sym.v, WSZ*sizeof(char)) == 0);
 	}
 	if (a->hdr.t == VLST) {
+		if (a->lst.v.n != b->lst.v.n) {
+			return false;
+		}
 		for (size_t i=0; i<a->lst.v.n; ++i) { 
 			if (!isequal_v(a->lst.v.v[i], b->lst.v.v[i])) {
 				return false;
@@ -917,6 +2017,9 @@ isequal_v(Val *a, Val *b) {
 		return true;
 	}
 	if (a->hdr.t == VSEQ) {
+		if (a->seq.v.n != b->seq.v.n) {
+			return false;
+		}
 		for (size_t i=0; i<a->seq.v.n; ++i) { 
 			if (!isequal_v(a->seq.v.v[i], b->seq.v.v[i])) {
 				return false;
@@ -924,7 +2027,16 @@ isequal_v(Val *a, Val *b) {
 		}
 		return true;
 	}
-	printf("? %s: unsupported value\n",
+	if (a->hdr.t == VGEN) {
+		/* the operators comparing elements get them made */
+		Gen *x = a->gen.v, *y = b->gen.v;
+		if (x->n != y->n || (x->n > 0 && x->from != y->from)
+				|| (x->f == NULL) != (y->f == NULL)) {
+			return false;
+		}
+		return x->f == NULL || isequal_v(x->f, y->f);
+	}
+	outf("? %s: unsupported value\n",
 			__FUNCTION__);
 	return false;
 }
@@ -932,12 +2044,25 @@ isequal_v(Val *a, Val *b) {
 static bool
 isequiv_v(Val *a, Val *b) {
 	assert(a != NULL && b != NULL);
+	if (hash_differ(a, b)) {
+		return false;
+	}
+	if (islst_v(a) && islst_v(b) 
+			&& (a->hdr.t != VLST || b->hdr.t != VLST)) {
+		return isequal_arr(a, b, isequiv_v);
+	}
 	if (a->hdr.t == VNAT && b->hdr.t == VREA) {
 		return ((double)a->nat.v == b->rea.v);
 	}
 	if (a->hdr.t == VREA && b->hdr.t == VNAT) {
 		return (a->rea.v == (double)b->nat.v);
 	}
+	if (a->hdr.t == VBIG && b->hdr.t == VREA) {
+		return (dbl_of_big(a->big.v) == b->rea.v);
+	}
+	if (a->hdr.t == VREA && b->hdr.t == VBIG) {
+		return (a->rea.v == dbl_of_big(b->big.v));
+	}
 	if (a->hdr.t != b->hdr.t) {
 		return false;
 	}
@@ -950,6 +2075,9 @@ isequiv_v(Val *a, Val *b) {
 	if (a->hdr.t == VREA) {
 		return (a->rea.v == b->rea.v);
 	}
+	if (a->hdr.t == VBIG) {
+		return isequal_v(a, b);
+	}
 	if (a->hdr.t == VOPE) {
 		return (a->symop.v == b->symop.v);
 	}
@@ -957,31 +2085,23 @@ isequiv_v(Val *a, Val *b) {
 		return (strncmp(a->symf.name, b->symf.name, WSZ*sizeof(char)) == 0);
 	}
 	if (a->hdr.t == VSYM) {
-		if (strncmp(a->sym.v, b->sym.v, WSZ*sizeof(char)) != 0) {
-			return false;
-		}
-		if (a->symf.param.n != b->symf.param.n) {
-			return false;
-		}
-		if (a->symf.body.n != b->symf.body.n) {
+		return (strncmp(a->sym.v, b->sym.v, WSZ*sizeof(char)) == 0);
+	}
+	if (a->hdr.t == VLST || a->hdr.t == VSEQ) {
+		if (a->seq.v.n != b->seq.v.n) {
 			return false;
 		}
-		for (size_t i=0; i<a->symf.body.n; ++i) { 
-			if (!isequiv_v(a->symf.body.v[i], b->symf.body.v[i])) {
+		for (size_t i=0; i<a->seq.v.n; ++i) { 
+			if (!isequiv_v(a->seq.v.v[i], b->seq.v.v[i])) {
 				return false;
 			}
 		}
 		return true;
 	}
-	if (a->hdr.t == VLST) {
-		for (size_t i=0; i<a->lst.v.n; ++i) { 
-			if (!isequiv_v(a->lst.v.v[i], b->lst.v.v[i])) {
-				return false;
-			}
-		}
-		return true;
+	if (a->hdr.t == VGEN) {
+		return isequal_v(a, b);
 	}
-	printf("? %s: unsupported value\n",
+	outf("? %s: unsupported value\n",
 			__FUNCTION__);
 	return false;
 }
@@ -990,6 +2110,7 @@ copy_v(Val *a) {
 	assert(a != NULL);
 	Val *b = malloc(sizeof(*b));
 	memcpy(b, a, sizeof(Val));
+	b->hdr.lent = false;
 	if (a->hdr.t == VSEQ || a->hdr.t == VLST) {
 		if (a->seq.v.n > 0) {
 			b->seq.v.v = malloc(a->seq.v.n * sizeof(Val*));
@@ -999,6 +2120,11 @@ copy_v(Val *a) {
 		} else {
 			b->seq.v.v = NULL;
 		}
+		if (a->hdr.t == VLST && b->lst.h == 0) {
+			/* lists are copied out of the env to be used:
+			 * hash the copy, and keep it in the original too */
+			__atomic_store_n(&a->lst.h, hash_v(b), __ATOMIC_RELAXED);
+		}
 	} else if (a->hdr.t == VFUN) {
 		if (a->symf.param.n > 0) {
 			b->symf.param.v = malloc(a->symf.param.n * sizeof(Val*));
@@ -1016,6 +2142,18 @@ copy_v(Val *a) {
 		} else {
 			b->symf.body.v = NULL;
 		}
+		ref_frame(b->symf.cap);
+		if (b->symf.code != NULL) {
+			__atomic_add_fetch(&b->symf.code->refs, 1, __ATOMIC_RELAXED);
+		}
+	} else if (a->hdr.t == VARR) {
+		__atomic_add_fetch(&b->arr.v->refs, 1, __ATOMIC_RELAXED);
+	} else if (a->hdr.t == VBIG) {
+		__atomic_add_fetch(&b->big.v->refs, 1, __ATOMIC_RELAXED);
+	} else if (a->hdr.t == VVEC) {
+		vn_ref(b->vec.v);
+	} else if (a->hdr.t == VGEN) {
+		__atomic_add_fetch(&b->gen.v->refs, 1, __ATOMIC_RELAXED);
 	}
 	return b;
 }
@@ -1040,7 +2178,7 @@ static Val *
 push_v(vtype t, Val *a, Val *b) {
 	assert(b != NULL && "val is null");
 	if (t != VSEQ && t != VLST) {
-		printf("? %s: not a seq or list\n",
+		outf("? %s: not a seq or list\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -1052,26 +2190,218 @@ push_v(vtype t, Val *a, Val *b) {
 		a->seq.v.v = NULL;
 	}
 	a->seq.v = push_l(a->seq.v, b);
+	touch_v(a);
+	return a;
+}
+static Val *
+pack_v(Val *a, vtype t) {
+	/* fresh array from list a, all numbers of type t */
+	Val *b = arr_v(t, a->lst.v.n);
+	for (size_t i=0; i<a->lst.v.n; ++i) {
+		if (t == VNAT) {
+			b->arr.v->v.nat[i] = a->lst.v.v[i]->nat.v;
+		} else {
+			b->arr.v->v.rea[i] = a->lst.v.v[i]->rea.v;
+		}
+	}
+	return b;
+}
+static Val *
+unpack_v(Val *a) {
+	/* fresh list from array or vector a */
+	Val *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->hdr.t = VLST;
+	b->lst.h = 0;
+	b->lst.v.n = len_v(a);
+	b->lst.v.v = NULL;
+	if (b->lst.v.n > 0) {
+		b->lst.v.v = malloc(b->lst.v.n * sizeof(Val*));
+		assert(b->lst.v.v != NULL);
+	}
+	if (a->hdr.t == VVEC) {
+		vn_fill(a->vec.v, b->lst.v.v);
+		return b;
+	}
+	Val tmp;
+	for (size_t i=0; i<b->lst.v.n; ++i) {
+		b->lst.v.v[i] = copy_v(elem_v(a, i, &tmp));
+	}
+	return b;
+}
+
+/* --- persistent vectors: building --- */
+
+static int
+vn_ht(Vnode *a) {
+	return a != NULL ? a->ht : 0;
+}
+static Vnode *
+vn_leaf(Val *v) {
+	/* v is stolen */
+	Vnode *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->refs = 1;
+	a->n = 1;
+	a->ht = 1;
+	a->h = 0;
+	a->l = a->r = NULL;
+	a->v = v;
+	return a;
+}
+static Vnode *
+vn_node(Vnode *l, Vnode *r) {
+	/* inner node over l and r (borrowed, both not NULL) */
+	Vnode *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->refs = 1;
+	a->n = l->n + r->n;
+	a->ht = 1 + (l->ht > r->ht ? l->ht : r->ht);
+	a->h = 0;
+	a->l = vn_ref(l);
+	a->r = vn_ref(r);
+	a->v = NULL;
 	return a;
 }
+static Vnode *
+vn_bal(Vnode *l, Vnode *r) {
+	/* as vn_node, heights of l and r differing by 2 at most */
+	Vnode *a, *b, *c;
+	int d = l->ht - r->ht;
+	if (d > 1) {
+		if (vn_ht(l->l) >= vn_ht(l->r)) {
+			a = vn_node(l->r, r);
+			c = vn_node(l->l, a);
+			vn_free(a);
+			return c;
+		}
+		a = vn_node(l->l, l->r->l);
+		b = vn_node(l->r->r, r);
+		c = vn_node(a, b);
+		vn_free(a);
+		vn_free(b);
+		return c;
+	}
+	if (d < -1) {
+		if (vn_ht(r->r) >= vn_ht(r->l)) {
+			a = vn_node(l, r->l);
+			c = vn_node(a, r->r);
+			vn_free(a);
+			return c;
+		}
+		a = vn_node(l, r->l->l);
+		b = vn_node(r->l->r, r->r);
+		c = vn_node(a, b);
+		vn_free(a);
+		vn_free(b);
+		return c;
+	}
+	return vn_node(l, r);
+}
+static Vnode *
+vn_join(Vnode *l, Vnode *r) {
+	/* l followed by r (borrowed), in O(log n) */
+	if (l == NULL) {
+		return vn_ref(r);
+	}
+	if (r == NULL) {
+		return vn_ref(l);
+	}
+	Vnode *t, *c;
+	if (l->ht > r->ht + 1) {
+		t = vn_join(l->r, r);
+		c = vn_bal(l->l, t);
+		vn_free(t);
+		return c;
+	}
+	if (r->ht > l->ht + 1) {
+		t = vn_join(l, r->l);
+		c = vn_bal(t, r->r);
+		vn_free(t);
+		return c;
+	}
+	return vn_node(l, r);
+}
+static Vnode *
+vn_set(Vnode *a, size_t i, Val *v) {
+	/* a with its i-th element replaced by v (stolen), i < a->n */
+	if (a->v != NULL) {
+		return vn_leaf(v);
+	}
+	Vnode *t, *c;
+	if (i < a->l->n) {
+		t = vn_set(a->l, i, v);
+		c = vn_node(t, a->r);
+	} else {
+		t = vn_set(a->r, i - a->l->n, v);
+		c = vn_node(a->l, t);
+	}
+	vn_free(t);
+	return c;
+}
+static Vnode *
+vn_build(Val **v, size_t n) {
+	/* balanced tree of the n values v (stolen) */
+	if (n == 0) {
+		return NULL;
+	}
+	if (n == 1) {
+		return vn_leaf(v[0]);
+	}
+	Vnode *l = vn_build(v, n/2);
+	Vnode *r = vn_build(v + n/2, n - n/2);
+	Vnode *c = vn_node(l, r);
+	vn_free(l);
+	vn_free(r);
+	return c;
+}
+static Val *
+vec_v(Vnode *a) {
+	/* vector value holding a (stolen) */
+	Val *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->hdr.t = VVEC;
+	b->vec.v = a;
+	return b;
+}
+static Vnode *
+vn_of(Val *a) {
+	/* tree of a list, array or vector a, new reference */
+	if (a->hdr.t == VVEC) {
+		return vn_ref(a->vec.v);
+	}
+	size_t n = len_v(a);
+	if (n == 0) {
+		return NULL;
+	}
+	Val **v = malloc(n * sizeof(*v));
+	assert(v != NULL);
+	Val tmp;
+	for (size_t i=0; i<n; ++i) {
+		v[i] = copy_v(elem_v(a, i, &tmp));
+	}
+	Vnode *c = vn_build(v, n);
+	free(v);
+	return c;
+}
 static void
 print_symval(Symval *a, const char *pfx) {
 	assert(a != NULL);
-	printf("%s = ", a->name);
+	outf("%s = ", a->name);
 	printx_v(a->v, false, pfx);
 }
 static void
 print_env(Env *a, const char *col1) {
 	assert(a != NULL);
-	printf("%s env: ", col1);
-	printf("state = "); print_istate(a->state); printf("\n");
+	outf("%s env: ", col1);
+	outf("state = "); print_istate(a->state); outf("\n");
 	for (size_t i=0; i<a->n; ++i) {
-		printf("%s ", col1);
+		outf("%s ", col1);
 		print_symval(a->s[i], col1);
-		printf("\n");
+		outf("\n");
 	}
 	if (a->parent) {
-		printf("%s parent\n", col1);
+		outf("%s parent\n", col1);
 		print_env(a->parent, col1);
 	}
 }
@@ -1080,26 +2410,35 @@ symval(char *a, Val *b) {
 	assert(a != NULL && "name is null");
 	assert(b != NULL && "val is null");
 	if (strlen(a) == 0) {
-		printf("? %s: empty name\n",
+		outf("? %s: empty name\n",
 				__FUNCTION__);
 		return NULL;
 	};
 	if (strlen(a) >= WSZ) {
-		printf("? %s: symbol name too long (%s)\n",
+		outf("? %s: symbol name too long (%s)\n",
 				__FUNCTION__, a);
 		return NULL;
 	};
 	Symval *c = malloc(sizeof(*c));
 	strncpy(c->name, a, WSZ*sizeof(char));
 	c->v = copy_v(b);
+	c->refs = 1;
 	return c;
 }
 static void
 free_symval(Symval *a) {
 	assert(a != NULL);
+	if (__atomic_sub_fetch(&a->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
+	}
 	free_v(a->v);
 	free(a);
 }
+static Symval *
+ref_symval(Symval *a) {
+	__atomic_add_fetch(&a->refs, 1, __ATOMIC_RELAXED);
+	return a;
+}
 static void 
 free_env(Env *a, bool global) {
 	if (a == NULL) {
@@ -1109,6 +2448,7 @@ free_env(Env *a, bool global) {
 		free_symval(a->s[i]);
 	}
 	free(a->s);
+	free_frame(a->cap);
 	if (global && a->parent) {
 		free_env(a->parent, global);
 	}
@@ -1119,7 +2459,7 @@ lookup_id(Env *a, char *b, bool global, size_t *id) {
 	assert(a != NULL && "env is null");
 	assert(b != NULL && "name is null");
 	if (strlen(b) == 0) {
-		printf("? %s: symbol name null\n",
+		outf("? %s: symbol name null\n",
 				__FUNCTION__);
 		return NULL;
 	}
@@ -1133,6 +2473,16 @@ lookup_id(Env *a, char *b, bool global, size_t *id) {
 			return c;
 		}
 	}
+	/* then in what the running function captured, 
+	 * read only: no slot id for them */
+	if (a->cap && id == NULL) {
+		for (size_t i=0; i<a->cap->n; ++i) {
+			Symval *c = a->cap->s[i];
+			if (strncmp(c->name, b, sizeof(c->name)) == 0) {
+				return c;
+			}
+		}
+	}
 	if (global && a->parent) {
 		return lookup_id(a->parent, b, global, id);
 	}
@@ -1154,7 +2504,7 @@ lookup(Env *a, char *b, bool global, bool iterate) {
 				return NULL;
 			}
 			if (isequal_v(sv->v, c)) {
-				printf("? %s: cyclic definition for '%s\n",
+				outf("? %s: cyclic definition for '%s\n",
 						__FUNCTION__, c->sym.v);
 				return NULL;
 			}
@@ -1164,13 +2514,26 @@ lookup(Env *a, char *b, bool global, bool iterate) {
 	return sv->v;
 }
 
+/* symbol caches: a symbol of a stored body (site) remembers, per thread, 
+ * the binding it found from an env; valid while no binding of the 
+ * name was added, replaced or dropped (generation of the name's slot) */
+#define SGSZ 1024
+#define ICSZ 1024	/* entries of the per thread caches */
+static uint64_t Symgen[SGSZ];
+static uint64_t Envids;
+
+static void
+bump_sym(const char *name) {
+	__atomic_add_fetch(&Symgen[hash_str(name) % SGSZ], 1, __ATOMIC_RELAXED);
+}
+
 static bool
 added_sym(Env *a, Symval *b, bool err) {
 	assert(a != NULL && "environment null");
 	assert(b != NULL && "symbol null");
 	if (lookup(a, b->name, false, false) != NULL) {
 		if (err) {
-			printf("? %s: symbol already defined (%s)\n",
+			outf("? %s: symbol already defined (%s)\n",
 					__FUNCTION__, b->name);
 		}
 		return false;
@@ -1185,6 +2548,7 @@ added_sym(Env *a, Symval *b, bool err) {
 	}
 	++(a->n);
 	a->s = c;
+	bump_sym(b->name);
 	return true;
 }
 static bool
@@ -1196,15 +2560,29 @@ upded_sym(Env *a, Symval *b, bool err) {
 	Symval *c = lookup_id(a, b->name, false, &id);
 	if (c == NULL) {
 		if (err) {
-			printf("? %s: symbol not found ('%s)\n",
+			outf("? %s: symbol not found ('%s)\n",
 					__FUNCTION__, b->name);
 		}
 		return false;
 	}
 	free_symval(c);
 	a->s[id] = b;
+	bump_sym(b->name);
 	return true;
 }
+static Symval *
+own_sym(Env *a, size_t id) {
+	/* a's binding id, to be written in place: 
+	 * if a frame holds it too, a copy replaces it here */
+	Symval *c = a->s[id];
+	if (__atomic_load_n(&c->refs, __ATOMIC_ACQUIRE) == 1) {
+		return c;
+	}
+	a->s[id] = symval(c->name, c->v);
+	free_symval(c);
+	bump_sym(a->s[id]->name);
+	return a->s[id];
+}
 static bool
 stored_sym(Env *a, Symval *b) {
 	if (upded_sym(a, b, false)) {
@@ -1229,10 +2607,20 @@ stored_sym(Env *a, Symval *b) {
  */
 
 static Ires eval_run(Env *e, Val *a, bool look, bool lookit);
+static Ires reduce_seq(Env *e, Val *b);
 static Ires solve_sym(Env *e, Val *a, bool look, bool lookit);
 static Ires copy_solve(Env *e, Val *a, bool lookall, bool lookit);
 static Ires solve_lst(Env *e, Val *a, bool look, bool lookit);
 static bool transition(Env *e, Val *a);
+static bool run_body(Env *e, Val *f, bool inloop);
+static Code *code_of(List_v b);
+static bool jit_call(Env *e, Val *f, Val **args, Val **r);
+static Val *lookup_ic(Env *e, Val *a);
+static bool isop_sym(Val *a);
+static long long save_image(Env *e, char *path);
+static Val *strict_arg(Env *e, Val *s, size_t p, Val *a);
+static Val *gen_at(Env *e, Val *a, size_t i);
+static bool print_gen(Env *e, Val *a);
 
 static bool 
 infixed(size_t p, size_t n) {
@@ -1246,12 +2634,16 @@ static bool
 prefixed2(size_t p, size_t n) {
 	return (p >= 0 && p < n-2);
 }
+static bool 
+prefixed3(size_t p, size_t n) {
+	return (p >= 0 && p+3 < n);
+}
 
 static bool
 set_infix_arg(Env *e, Val *s, size_t p, Val **pa, bool looka, Val **pb, bool lookb) {
 	*pa = *pb = NULL;
 	if (!infixed(p, s->seq.v.n)) {
-		printf("? %s: operator not infixed\n", 
+		outf("? %s: operator not infixed\n", 
 				__FUNCTION__);
 		return false;
 	}
@@ -1259,21 +2651,29 @@ set_infix_arg(Env *e, Val *s, size_t p, Val **pa, bool looka, Val **pb, bool loo
 	if (rc.code != OK && rc.code != NOP) {
 		return false;
 	}
-	*pa = rc.v;
+	*pa = strict_arg(e, s, p, rc.v);
+	if (*pa == NULL) {
+		return false;
+	}
 	rc = copy_solve(e, s->seq.v.v[p+1], lookb, true);
 	if (rc.code != OK && rc.code != NOP) {
 		free_v(*pa);
 		*pa = NULL;
 		return false;
 	}
-	*pb = rc.v;
+	*pb = strict_arg(e, s, p, rc.v);
+	if (*pb == NULL) {
+		free_v(*pa);
+		*pa = NULL;
+		return false;
+	}
 	return true;
 }
 static bool
 set_prefix1_arg(Env *e, Val *s, size_t p, Val **pa, bool looka) {
 	*pa = NULL;
 	if (!prefixed1(p, s->seq.v.n)) {
-		printf("? %s: symbol not prefixed to one argument\n", 
+		outf("? %s: symbol not prefixed to one argument\n", 
 				__FUNCTION__);
 		return false;
 	}
@@ -1281,14 +2681,14 @@ set_prefix1_arg(Env *e, Val *s, size_t p, Val **pa, bool looka) {
 	if (rc.code != OK && rc.code != NOP) {
 		return false;
 	}
-	*pa = rc.v;
-	return true;
+	*pa = strict_arg(e, s, p, rc.v);
+	return *pa != NULL;
 }
 static bool
 set_prefix2_arg(Env *e, Val *s, size_t p, Val **pa, bool looka, Val **pb, bool lookb) {
 	*pa = *pb = NULL;
 	if (!prefixed2(p, s->seq.v.n)) {
-		printf("? %s: symbol not prefixed to 2 arguments\n", 
+		outf("? %s: symbol not prefixed to 2 arguments\n", 
 				__FUNCTION__);
 		return false;
 	}
@@ -1296,23 +2696,57 @@ set_prefix2_arg(Env *e, Val *s, size_t p, Val **pa, bool looka, Val **pb, bool l
 	if (rc.code != OK && rc.code != NOP) {
 		return false;
 	}
-	*pa = rc.v;
+	*pa = strict_arg(e, s, p, rc.v);
+	if (*pa == NULL) {
+		return false;
+	}
 	rc = copy_solve(e, s->seq.v.v[p+2], lookb, true);
 	if (rc.code != OK && rc.code != NOP) {
 		free_v(*pa);
 		*pa = NULL;
 		return false;
 	}
-	*pb = rc.v;
+	*pb = strict_arg(e, s, p, rc.v);
+	if (*pb == NULL) {
+		free_v(*pa);
+		*pa = NULL;
+		return false;
+	}
+	return true;
+}
+static bool
+set_prefix3_arg(Env *e, Val *s, size_t p, Val **pa, Val **pb, Val **pc) {
+	/* all 3 arguments are looked up */
+	*pa = *pb = *pc = NULL;
+	if (!prefixed3(p, s->seq.v.n)) {
+		outf("? %s: symbol not prefixed to 3 arguments\n", 
+				__FUNCTION__);
+		return false;
+	}
+	Val **pv[3] = {pa, pb, pc};
+	for (size_t i=0; i<3; ++i) {
+		Ires rc = copy_solve(e, s->seq.v.v[p+1+i], true, true);
+		if (rc.code == OK || rc.code == NOP) {
+			rc.v = strict_arg(e, s, p, rc.v);
+		}
+		if ((rc.code != OK && rc.code != NOP) || rc.v == NULL) {
+			for (size_t j=0; j<i; ++j) {
+				free_v(*pv[j]);
+				*pv[j] = NULL;
+			}
+			return false;
+		}
+		*pv[i] = rc.v;
+	}
 	return true;
 }
 static bool
 set_prefixn_arg(Env *e, Val *s, size_t p, Val **pa, bool looka) {
 	*pa = NULL;
 	if (p == s->seq.v.n -1) {
-		printf("? %s: arguments expected for ", __FUNCTION__);
+		outf("? %s: arguments expected for ", __FUNCTION__);
 		print_v(s->seq.v.v[p], true);
-		printf("\n");
+		outf("\n");
 		return false;
 	}
 	Ires rc;
@@ -1320,11 +2754,16 @@ set_prefixn_arg(Env *e, Val *s, size_t p, Val **pa, bool looka) {
 	for (size_t i=p+1; i < s->seq.v.n; ++i) {
 		rc = copy_solve(e, s->seq.v.v[i], looka, true);
 		if (rc.code != OK && rc.code != NOP) {
-			printf("? %s: %luth argument unknown\n", 
+			outf("? %s: %luth argument unknown\n", 
 					__FUNCTION__, i);
 			free_v(b);
 			return false;
 		}
+		rc.v = strict_arg(e, s, p, rc.v);
+		if (rc.v == NULL) {
+			free_v(b);
+			return false;
+		}
 		b = push_v(VSEQ, b, rc.v);
 	}
 	*pa = b;
@@ -1334,7 +2773,7 @@ static void
 upd_infix(Val *s, size_t p, Val *a) {
 	/* consumed 2 seq items */
 	for (size_t i=p-1; i < s->seq.v.n && i < p+2; ++i) {
-		free_v(s->seq.v.v[i]);
+		drop_v(s->seq.v.v[i]);
 	}
 	s->seq.v.v[p-1] = a;
 	for (size_t i=p+2; i < s->seq.v.n; ++i) {
@@ -1346,7 +2785,7 @@ static void
 upd_prefixk(Val *s, size_t p, Val *a, size_t k) {
 	/* consume k+1 seq item */
 	for (size_t i=p; i < s->seq.v.n && i < p+k+1; ++i) {
-		free_v(s->seq.v.v[i]);
+		drop_v(s->seq.v.v[i]);
 	}
 	s->seq.v.v[p] = a;
 	for (size_t i=p+k+1; i < s->seq.v.n; ++i) {
@@ -1370,270 +2809,558 @@ upd_prefix2(Val *s, size_t p, Val *a) {
 	upd_prefixk(s, p, a, 2);
 }
 static void
+upd_prefix3(Val *s, size_t p, Val *a) {
+	/* consume 3 seq item */
+	upd_prefixk(s, p, a, 3);
+}
+static void
 upd_prefixall(Val *s, size_t p, Val *a) {
 	/* consume n-p-1 (all remaining items) seq item */
 	upd_prefixk(s, p, a, s->seq.v.n - p - 1);
 }
 
-static Ires 
-op_mul(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
-	}
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a); 
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
-	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v *= b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->hdr.t = VREA;
-		a->rea.v = (double)a->nat.v * b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->rea.v *= (double)b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->rea.v *= b->rea.v;
-	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+/* ------ numeric operators: scalars, and elementwise over lists ------ 
+ * a list broadcasts against a scalar (2 * (1, 2) is 2, 4),
+ * two lists of the same length combine element by element,
+ * sub-lists are handled recursively.
+ * Naturals overflowing long long are promoted to big naturals,
+ * and big results fitting a long long are demoted back.
+ */
+
+typedef enum { NADD, NSUB, NMUL, NDIV, NLES, NLEQ, NGRE, NGEQ } nop;
+
+typedef enum {
+	AOK,
+	ANAN,	/* an argument is not a number */
+	AZERO,	/* division by 0 */
+	ALEN,	/* lists of different lengths */
+	AOVF	/* a kernel overflowed long long (retried element by element) */
+} arc;
+
+static bool
+iscmp_n(nop o) {
+	return o == NLES || o == NLEQ || o == NGRE || o == NGEQ;
 }
-static Ires 
-op_div(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+
+static bool
+isnum_v(Val *a) {
+	return a->hdr.t == VNAT || a->hdr.t == VREA || a->hdr.t == VBIG;
+}
+
+static void
+num_big(nop o, Val *a, Val *b, Val *r) {
+	/* naturals and big naturals, the exact way */
+	Bigv x, y;
+	bigv_of(a, &x);
+	bigv_of(b, &y);
+	Val *c = NULL;
+	switch (o) {
+		case NADD: c = big_add(&x, &y, y.neg); break;
+		case NSUB: c = big_add(&x, &y, !y.neg); break;
+		case NMUL: c = big_mul(&x, &y); break;
+		case NDIV: c = big_div(&x, &y); break;
+		default: 
+			r->hdr.t = VNAT;
+			r->hdr.lent = false;
+			int k = big_cmp(&x, &y);
+			r->nat.v = o == NLES ? k < 0 : (o == NLEQ ? k <= 0 
+					: (o == NGRE ? k > 0 : k >= 0));
+			return;
+	}
+	memcpy(r, c, sizeof(*r));
+	free(c);
+}
+
+static arc
+num_scalar(nop o, Val *a, Val *b, Val *r) {
+	/* r gets the result, it must not be a or b */
+	if (o == NDIV && ((b->hdr.t == VNAT && b->nat.v == 0) 
+			|| (b->hdr.t == VREA && b->rea.v == 0.))) {
+		return AZERO;
 	}
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
+	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
+		long long x = a->nat.v;
+		long long y = b->nat.v;
+		bool ovf = false;
+		r->hdr.t = VNAT;
+		r->hdr.lent = false;
+		switch (o) {
+			case NADD: ovf = __builtin_add_overflow(x, y, &r->nat.v); break;
+			case NSUB: ovf = __builtin_sub_overflow(x, y, &r->nat.v); break;
+			case NMUL: ovf = __builtin_mul_overflow(x, y, &r->nat.v); break;
+			case NDIV: 
+				ovf = x == LLONG_MIN && y == -1;
+				r->nat.v = ovf ? 0 : x / y; 
+				break;
+			case NLES: r->nat.v = x < y; break;
+			case NLEQ: r->nat.v = x <= y; break;
+			case NGRE: r->nat.v = x > y; break;
+			case NGEQ: r->nat.v = x >= y; break;
+		}
+		if (ovf) {
+			num_big(o, a, b, r);
+		}
+		return AOK;
+	}
+	if (a->hdr.t != VREA && b->hdr.t != VREA) {
+		/* at least one big natural */
+		num_big(o, a, b, r);
+		return AOK;
+	}
+	double x = a->hdr.t == VNAT ? (double)a->nat.v 
+		: (a->hdr.t == VBIG ? dbl_of_big(a->big.v) : a->rea.v);
+	double y = b->hdr.t == VNAT ? (double)b->nat.v 
+		: (b->hdr.t == VBIG ? dbl_of_big(b->big.v) : b->rea.v);
+	r->hdr.lent = false;
+	if (iscmp_n(o)) {
+		r->hdr.t = VNAT;
+	} else {
+		r->hdr.t = VREA;
+	}
+	switch (o) {
+		case NADD: r->rea.v = x + y; break;
+		case NSUB: r->rea.v = x - y; break;
+		case NMUL: r->rea.v = x * y; break;
+		case NDIV: r->rea.v = x / y; break;
+		case NLES: r->nat.v = x < y; break;
+		case NLEQ: r->nat.v = x <= y; break;
+		case NGRE: r->nat.v = x > y; break;
+		case NGEQ: r->nat.v = x >= y; break;
+	}
+	return AOK;
+}
+
+/* kernels: dx, dy are 0 (broadcast scalar) or 1 (walk the array) */
+static arc
+kern_nat(nop o, const long long *x, size_t dx, const long long *y, size_t dy, 
+		long long *r, size_t n) {
+	if (o == NDIV) {
+		for (size_t i=0; i<n; ++i) {
+			if (y[i*dy] == 0) {
+				return AZERO;
+			}
+		}
 	}
-	if ((b->hdr.t == VNAT && b->nat.v == 0) 
-			|| (b->hdr.t == VREA && b->rea.v == 0.)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: division by 0\n", 
-				__FUNCTION__);
-		return rc;
+	/* overflows are or-ed, the loops stay branch free */
+	bool v = false;
+	long long *t = r;
+	switch (o) {
+		case NADD: for (size_t i=0; i<n; ++i) v |= __builtin_add_overflow(x[i*dx], y[i*dy], t+i); break;
+		case NSUB: for (size_t i=0; i<n; ++i) v |= __builtin_sub_overflow(x[i*dx], y[i*dy], t+i); break;
+		case NMUL: for (size_t i=0; i<n; ++i) v |= __builtin_mul_overflow(x[i*dx], y[i*dy], t+i); break;
+		case NDIV: 
+			for (size_t i=0; i<n; ++i) {
+				if (x[i*dx] == LLONG_MIN && y[i*dy] == -1) {
+					return AOVF;
+				}
+				r[i] = x[i*dx] / y[i*dy];
+			}
+			break;
+		case NLES: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] < y[i*dy]; break;
+		case NLEQ: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] <= y[i*dy]; break;
+		case NGRE: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] > y[i*dy]; break;
+		case NGEQ: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] >= y[i*dy]; break;
 	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v /= b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->hdr.t = VREA;
-		a->rea.v = (double)a->nat.v / b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->rea.v /= (double)b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->rea.v /= b->rea.v;
+	return v ? AOVF : AOK;
+}
+static arc
+kern_rea(nop o, const double *x, size_t dx, const double *y, size_t dy, 
+		double *r, long long *q, size_t n) {
+	/* arithmetic results in r, comparisons in q */
+	if (o == NDIV) {
+		for (size_t i=0; i<n; ++i) {
+			if (y[i*dy] == 0.) {
+				return AZERO;
+			}
+		}
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+	switch (o) {
+		case NADD: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] + y[i*dy]; break;
+		case NSUB: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] - y[i*dy]; break;
+		case NMUL: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] * y[i*dy]; break;
+		case NDIV: for (size_t i=0; i<n; ++i) r[i] = x[i*dx] / y[i*dy]; break;
+		case NLES: for (size_t i=0; i<n; ++i) q[i] = x[i*dx] < y[i*dy]; break;
+		case NLEQ: for (size_t i=0; i<n; ++i) q[i] = x[i*dx] <= y[i*dy]; break;
+		case NGRE: for (size_t i=0; i<n; ++i) q[i] = x[i*dx] > y[i*dy]; break;
+		case NGEQ: for (size_t i=0; i<n; ++i) q[i] = x[i*dx] >= y[i*dy]; break;
+	}
+	return AOK;
 }
-static Ires
-op_plu(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+
+static vtype
+homog_v(Val *a) {
+	/* VNAT or VREA if a number, or a list or array of numbers of one type */
+	if (a->hdr.t == VNAT || a->hdr.t == VREA) {
+		return a->hdr.t;
 	}
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
+	if (a->hdr.t == VARR) {
+		return a->arr.v->n > 0 ? a->arr.v->t : VNIL;
 	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v += b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->hdr.t = VREA;
-		a->rea.v = (double)a->nat.v + b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->rea.v += (double)b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->rea.v += b->rea.v;
+	if (a->hdr.t != VLST || a->lst.v.n == 0) {
+		return VNIL;
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+	vtype t = a->lst.v.v[0]->hdr.t;
+	if (t != VNAT && t != VREA) {
+		return VNIL;
+	}
+	for (size_t i=1; i<a->lst.v.n; ++i) {
+		if (a->lst.v.v[i]->hdr.t != t) {
+			return VNIL;
+		}
+	}
+	return t;
 }
-static Ires 
-op_min(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+
+static const long long *
+data_nat(Val *a, long long **buf) {
+	/* a's naturals in a contiguous buffer, *buf is set if allocated */
+	*buf = NULL;
+	if (a->hdr.t == VARR) {
+		return a->arr.v->v.nat;
 	}
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers in \"", 
-				__FUNCTION__);
-		print_v(s, false);
-		printf("\"\n");
-		return rc;
+	if (a->hdr.t == VNAT) {
+		return &(a->nat.v);
 	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v -= b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->hdr.t = VREA;
-		a->rea.v = (double)a->nat.v - b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->rea.v -= (double)b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->rea.v -= b->rea.v;
+	*buf = malloc(a->lst.v.n * sizeof(**buf));
+	assert(*buf != NULL);
+	for (size_t i=0; i<a->lst.v.n; ++i) {
+		(*buf)[i] = a->lst.v.v[i]->nat.v;
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+	return *buf;
 }
-static Ires
-op_les(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+static const double *
+data_rea(Val *a, double **buf) {
+	/* as data_nat, naturals converted to reals */
+	*buf = NULL;
+	if (a->hdr.t == VARR && a->arr.v->t == VREA) {
+		return a->arr.v->v.rea;
 	}
-	/* to be expanded to other types */
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
+	if (a->hdr.t == VREA) {
+		return &(a->rea.v);
 	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v = a->nat.v < b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->nat.v = a->nat.v < b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->nat.v < b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->rea.v < b->rea.v;
+	size_t n = isnum_v(a) ? 1 : len_v(a);
+	*buf = malloc(n * sizeof(**buf));
+	assert(*buf != NULL);
+	Val tmp, *c;
+	for (size_t i=0; i<n; ++i) {
+		c = isnum_v(a) ? a : elem_v(a, i, &tmp);
+		(*buf)[i] = c->hdr.t == VNAT ? (double)c->nat.v : c->rea.v;
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+	return *buf;
 }
-static Ires
-op_leq(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+
+static Val *
+num_kernel(nop o, Val *a, vtype ta, Val *b, vtype tb, size_t n, arc *rc) {
+	/* homogeneous operands: run the kernel straight into a fresh array */
+	size_t dx = isnum_v(a) ? 0 : 1;
+	size_t dy = isnum_v(b) ? 0 : 1;
+	bool isnat = ta == VNAT && tb == VNAT;
+	Val *c = arr_v((isnat || iscmp_n(o)) ? VNAT : VREA, n);
+	if (isnat) {
+		long long *bx, *by;
+		const long long *x = data_nat(a, &bx);
+		const long long *y = data_nat(b, &by);
+		*rc = kern_nat(o, x, dx, y, dy, c->arr.v->v.nat, n);
+		free(bx);
+		free(by);
+	} else {
+		double *bx, *by;
+		const double *x = data_rea(a, &bx);
+		const double *y = data_rea(b, &by);
+		*rc = kern_rea(o, x, dx, y, dy, c->arr.v->v.rea, c->arr.v->v.nat, n);
+		free(bx);
+		free(by);
+	}
+	if (*rc != AOK) {
+		free_v(c);
+		return NULL;
 	}
-	/* to be expanded to other types */
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
+	return c;
+}
+
+static Val *
+num_v(nop o, Val *a, Val *b, arc *rc) {
+	/* returns a fresh value, or NULL and the reason in rc */
+	*rc = AOK;
+	if (isnum_v(a) && isnum_v(b)) {
+		Val *c = malloc(sizeof(*c));
+		assert(c != NULL);
+		*rc = num_scalar(o, a, b, c);
+		if (*rc != AOK) {
+			free(c);
+			return NULL;
+		}
+		return c;
+	}
+	if ((!islst_v(a) && !isnum_v(a)) || (!islst_v(b) && !isnum_v(b))) {
+		*rc = ANAN;
+		return NULL;
+	}
+	size_t n = islst_v(a) ? len_v(a) : len_v(b);
+	if (islst_v(a) && islst_v(b) && len_v(a) != len_v(b)) {
+		*rc = ALEN;
+		return NULL;
+	}
+	vtype ta = homog_v(a);
+	vtype tb = homog_v(b);
+	if (n > 0 && ta != VNIL && tb != VNIL) {
+		Val *c = num_kernel(o, a, ta, b, tb, n, rc);
+		if (*rc != AOVF) {
+			return c;
+		}
+		*rc = AOK;
+	}
+	/* general case, element by element */
+	Val *c = malloc(sizeof(*c));
+	assert(c != NULL);
+	c->hdr.t = VLST;
+	c->lst.h = 0;
+	c->lst.v.n = 0;
+	c->lst.v.v = NULL;
+	Val tx, ty;
+	for (size_t i=0; i<n; ++i) {
+		Val *x = islst_v(a) ? elem_v(a, i, &tx) : a;
+		Val *y = islst_v(b) ? elem_v(b, i, &ty) : b;
+		Val *d = num_v(o, x, y, rc);
+		if (d == NULL) {
+			free_v(c);
+			return NULL;
+		}
+		c->lst.v = push_l(c->lst.v, d);
 	}
+	return c;
+}
+
+/* type feedback: an operator of a stored body (site) counts, per thread, 
+ * the kinds of operands it gets; once it got OPWARM times the same kind 
+ * of numbers, it computes them directly, until it gets another kind */
+#define OPWARM 16
+#define OPDEOPTS 4	/* then left generic */
+typedef enum { KNONE, KNAT, KREA, KMIX, KOTHER } okind;
+typedef struct {
+	size_t site;	/* 0: unused */
+	okind kind;	/* of all the operands seen so far */
+	size_t n;	/* applications seen */
+	okind spec;	/* specialized for, or KNONE */
+	size_t deopts;
+} Tf;
+static __thread Tf Tfs[ICSZ];
+
+static okind
+kind_of(Val *a, Val *b) {
 	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v = a->nat.v <= b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->nat.v = a->nat.v <= b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->nat.v <= b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->rea.v <= b->rea.v;
+		return KNAT;
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
+	if (a->hdr.t == VREA && b->hdr.t == VREA) {
+		return KREA;
+	}
+	if ((a->hdr.t == VNAT || a->hdr.t == VREA) 
+			&& (b->hdr.t == VNAT || b->hdr.t == VREA)) {
+		return KMIX;
+	}
+	return KOTHER;
 }
-static Ires 
-op_gre(Env *e, Val *s, size_t p) {
-	Ires rc = (Ires) {FAIL, s};
-	Val *a, *b;
-	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
-		return rc;
+static Tf *
+tf_of(Val *op) {
+	/* op's feedback, NULL if op is not a site */
+	if (op->symop.site == 0) {
+		return NULL;
 	}
-	/* to be expanded to other types */
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
+	Tf *t = Tfs + op->symop.site % ICSZ;
+	if (t->site != op->symop.site) {
+		*t = (Tf) {op->symop.site, KNONE, 0, KNONE, 0};
 	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v = a->nat.v > b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->nat.v = a->nat.v > b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->nat.v > b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->rea.v > b->rea.v;
+	return t;
+}
+static void
+tf_saw(Tf *t, okind k, const char *fn) {
+	/* generic application of t's operator to operands of kind k */
+	if (t->spec != KNONE) {
+		/* guard failed: back to generic */
+		if (Dbg) { outf("# %s: site %zu generic again\n", fn, t->site); }
+		t->spec = KNONE;
+		t->n = 0;
+		++(t->deopts);
+	}
+	if (t->n == 0 || t->kind != k) {
+		t->kind = k;
+		t->n = 0;
+	}
+	++(t->n);
+	if (t->n >= OPWARM && k != KOTHER && t->deopts < OPDEOPTS) {
+		t->spec = k;
+		if (Dbg) { outf("# %s: site %zu specialized (%s)\n", fn, t->site, 
+				k == KNAT ? "nat" : (k == KREA ? "rea" : "mixed")); }
 	}
-	free_v(b);
-	upd_infix(s, p, a);
-	rc = (Ires) {OK, s};
-	return rc;
 }
-static Ires 
-op_geq(Env *e, Val *s, size_t p) {
+static Val *
+num_arg(Env *e, Val *a) {
+	/* a's number, borrowed, without copy; NULL if not one */
+	if (a->hdr.t == VSYM) {
+		if (strncmp(a->sym.v, IT, sizeof(a->sym.v)) == 0) {
+			a = lookup(e, ITNAME, false, false);
+		} else if (isop_sym(a)) {
+			return NULL;
+		} else {
+			a = lookup_ic(e, a);
+		}
+		if (a == NULL) {
+			return NULL;
+		}
+	}
+	return (a->hdr.t == VNAT || a->hdr.t == VREA) ? a : NULL;
+}
+static Val *
+num_fast(nop o, Val *a, Val *b, okind k) {
+	/* o on numbers a and b of kind k, a fresh value; 
+	 * NULL if left to the generic case (overflow, division by 0) */
+	Val *c = malloc(sizeof(*c));
+	assert(c != NULL);
+	c->hdr.lent = false;
+	if (k == KNAT) {
+		long long x = a->nat.v;
+		long long y = b->nat.v;
+		bool ovf = false;
+		c->hdr.t = VNAT;
+		switch (o) {
+			case NADD: ovf = __builtin_add_overflow(x, y, &c->nat.v); break;
+			case NSUB: ovf = __builtin_sub_overflow(x, y, &c->nat.v); break;
+			case NMUL: ovf = __builtin_mul_overflow(x, y, &c->nat.v); break;
+			case NDIV: 
+				ovf = y == 0 || (x == LLONG_MIN && y == -1);
+				c->nat.v = ovf ? 0 : x / y; 
+				break;
+			case NLES: c->nat.v = x < y; break;
+			case NLEQ: c->nat.v = x <= y; break;
+			case NGRE: c->nat.v = x > y; break;
+			case NGEQ: c->nat.v = x >= y; break;
+		}
+		if (ovf) {
+			free(c);
+			return NULL;
+		}
+	} else {
+		double x = a->hdr.t == VNAT ? (double)a->nat.v : a->rea.v;
+		double y = b->hdr.t == VNAT ? (double)b->nat.v : b->rea.v;
+		if (o == NDIV && y == 0.) {
+			free(c);
+			return NULL;
+		}
+		c->hdr.t = iscmp_n(o) ? VNAT : VREA;
+		switch (o) {
+			case NADD: c->rea.v = x + y; break;
+			case NSUB: c->rea.v = x - y; break;
+			case NMUL: c->rea.v = x * y; break;
+			case NDIV: c->rea.v = x / y; break;
+			case NLES: c->nat.v = x < y; break;
+			case NLEQ: c->nat.v = x <= y; break;
+			case NGRE: c->nat.v = x > y; break;
+			case NGEQ: c->nat.v = x >= y; break;
+		}
+	}
+	return c;
+}
+static int
+num_spec(Env *e, Val *s, size_t p, nop o, okind k) {
+	/* o at p, on operands of kind k, specialized: 1 if done, 
+	 * 0 if the operands are of another kind, -1 if left to 
+	 * the generic case (overflow, division by 0, ...) */
+	if (!infixed(p, s->seq.v.n)) {
+		return -1;
+	}
+	Val *a = num_arg(e, s->seq.v.v[p-1]);
+	Val *b = num_arg(e, s->seq.v.v[p+1]);
+	if (a == NULL || b == NULL) {
+		return 0;
+	}
+	if (kind_of(a, b) != k) {
+		return 0;
+	}
+	Val *c = num_fast(o, a, b, k);
+	if (c == NULL) {
+		return -1;
+	}
+	upd_infix(s, p, c);
+	return 1;
+}
+
+static Ires
+op_num(Env *e, Val *s, size_t p, nop o, const char *fn) {
+	/* infix numeric operator, shared by op_mul, op_plu, op_les, ... */
 	Ires rc = (Ires) {FAIL, s};
+	Tf *t = tf_of(s->seq.v.v[p]);
+	int k = 0;
+	if (t != NULL && t->spec != KNONE) {
+		k = num_spec(e, s, p, o, t->spec);
+		if (k == 1) {
+			return (Ires) {OK, s};
+		}
+	}
 	Val *a, *b;
 	if (!set_infix_arg(e, s, p, &a, true, &b, true)) {
 		return rc;
 	}
-	/* to be expanded to other types */
-	if ((a->hdr.t != VNAT && a->hdr.t != VREA)
-			|| (b->hdr.t != VNAT && b->hdr.t != VREA)) {
-		free_v(a);
-		free_v(b);
-		printf("? %s: arguments not numbers\n", 
-				__FUNCTION__);
-		return rc;
-	}
-	if (a->hdr.t == VNAT && b->hdr.t == VNAT) {
-		a->nat.v = a->nat.v >= b->nat.v;
-	} else if (a->hdr.t == VNAT && b->hdr.t == VREA) {
-		a->nat.v = a->nat.v >= b->rea.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VNAT) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->nat.v >= b->nat.v;
-	} else if (a->hdr.t == VREA && b->hdr.t == VREA) {
-		a->hdr.t = VNAT;
-		a->nat.v = a->rea.v >= b->rea.v;
+	if (t != NULL && k == 0) {
+		tf_saw(t, kind_of(a, b), fn);
 	}
+	arc r;
+	Val *c = num_v(o, a, b, &r);
+	free_v(a);
 	free_v(b);
-	upd_infix(s, p, a);
+	switch (r) {
+		case AOK:
+			break;
+		case ANAN:
+			outf("? %s: arguments not numbers in \"", fn);
+			print_v(s, false);
+			outf("\"\n");
+			return rc;
+		case AZERO:
+			outf("? %s: division by 0\n", fn);
+			return rc;
+		case ALEN:
+			outf("? %s: lists of different lengths\n", fn);
+			return rc;
+		case AOVF:
+			break;	/* never returned by num_v */
+	}
+	upd_infix(s, p, c);
 	rc = (Ires) {OK, s};
 	return rc;
 }
 static Ires 
+op_mul(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NMUL, __FUNCTION__);
+}
+static Ires 
+op_div(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NDIV, __FUNCTION__);
+}
+static Ires
+op_plu(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NADD, __FUNCTION__);
+}
+static Ires 
+op_min(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NSUB, __FUNCTION__);
+}
+static Ires
+op_les(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NLES, __FUNCTION__);
+}
+static Ires
+op_leq(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NLEQ, __FUNCTION__);
+}
+static Ires 
+op_gre(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NGRE, __FUNCTION__);
+}
+static Ires 
+op_geq(Env *e, Val *s, size_t p) {
+	return op_num(e, s, p, NGEQ, __FUNCTION__);
+}
+static Ires 
 op_eq(Env *e, Val *s, size_t p) {
 	Ires rc = (Ires) {FAIL, s};
 	Val *a, *b;
@@ -1642,6 +3369,7 @@ op_eq(Env *e, Val *s, size_t p) {
 	}
 	Val *c = malloc(sizeof(*c));
 	c->hdr.t = VNAT;
+	c->hdr.lent = false;
 	c->nat.v = isequal_v(a, b) ? 1 : 0;
 	free_v(a);
 	free_v(b);
@@ -1658,6 +3386,7 @@ op_neq(Env *e, Val *s, size_t p) {
 	}
 	Val *c = malloc(sizeof(*c));
 	c->hdr.t = VNAT;
+	c->hdr.lent = false;
 	c->nat.v = isequal_v(a, b) ? 0 : 1;
 	free_v(a);
 	free_v(b);
@@ -1674,6 +3403,7 @@ op_eqv(Env *e, Val *s, size_t p) {
 	}
 	Val *c = malloc(sizeof(*c));
 	c->hdr.t = VNAT;
+	c->hdr.lent = false;
 	c->nat.v = isequiv_v(a, b) ? 1 : 0;
 	free_v(a);
 	free_v(b);
@@ -1691,7 +3421,7 @@ op_and(Env *e, Val *s, size_t p) {
 	if ((a->hdr.t != VNAT) || (b->hdr.t != VNAT)) {
 		free_v(a);
 		free_v(b);
-		printf("? %s: arguments not natural numbers\n", 
+		outf("? %s: arguments not natural numbers\n", 
 				__FUNCTION__);
 		return rc;
 	}
@@ -1713,7 +3443,7 @@ op_or(Env *e, Val *s, size_t p) {
 	if ((a->hdr.t != VNAT) || (b->hdr.t != VNAT)) {
 		free_v(a);
 		free_v(b);
-		printf("? %s: arguments not natural numbers\n", 
+		outf("? %s: arguments not natural numbers\n", 
 				__FUNCTION__);
 		return rc;
 	}
@@ -1734,7 +3464,7 @@ op_not(Env *e, Val *s, size_t p) {
 	}
 	if ((a->hdr.t != VNAT)) {
 		free_v(a);
-		printf("? %s: argument not natural number (boolean)\n", 
+		outf("? %s: argument not natural number (boolean)\n", 
 				__FUNCTION__);
 		return rc;
 	}
@@ -1751,10 +3481,16 @@ op_print(Env *e, Val *s, size_t p) {
 	if (!set_prefix1_arg(e, s, p, &a, true)) {
 		return rc;
 	}
-	print_v(a, false);
-	printf("\n");
-	upd_prefix1(s, p, a);
-	rc = (Ires) {OK, s};
+	if (a->hdr.t == VGEN && !print_gen(e, a)) {
+		free_v(a);
+		return rc;
+	}
+	if (a->hdr.t != VGEN) {
+		print_v(a, false);
+	}
+	outf("\n");
+	upd_prefix1(s, p, a);
+	rc = (Ires) {OK, s};
 	return rc;
 }
 static Ires 
@@ -1775,9 +3511,14 @@ op_do(Env *e, Val *s, size_t p) {
 	if (!set_prefix1_arg(e, s, p, &a, true)) {
 		return (Ires) {FAIL, s};
 	}
+	if (a->hdr.t == VARR || a->hdr.t == VVEC) {
+		Val *b = unpack_v(a);
+		free_v(a);
+		a = b;
+	}
 	if (a->hdr.t != VLST) {
 		free_v(a);
-		printf("? %s: argument not a list\n", 
+		outf("? %s: argument not a list\n", 
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -1796,21 +3537,229 @@ op_list(Env *e, Val *s, size_t p) {
 		return (Ires) {FAIL, s};
 	}
 	a->hdr.t = VLST;
+	touch_v(a);
 	upd_prefixall(s, p, a);
 	return (Ires) {OK, s};
 }
 static Ires 
+op_range(Env *e, Val *s, size_t p) {
+	/* rem: range 0 3 is the array 0, 1, 2, long ones are lazy */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, true, &b, true)) {
+		return (Ires) {FAIL, s};
+	}
+	if (a->hdr.t != VNAT || b->hdr.t != VNAT) {
+		free_v(a);
+		free_v(b);
+		outf("? %s: arguments not natural numbers\n", 
+				__FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	/* the span in unsigned: from a negative to a positive, it can 
+	 * pass LLONG_MAX, that from + i (i < n) must keep under */
+	unsigned long long n = b->nat.v > a->nat.v 
+		? (unsigned long long)b->nat.v - (unsigned long long)a->nat.v : 0;
+	if (n > LLONG_MAX) {
+		free_v(a);
+		free_v(b);
+		outf("? %s: range longer than %lld\n", __FUNCTION__, LLONG_MAX);
+		return (Ires) {FAIL, s};
+	}
+	Val *c;
+	if (n >= LAZYMIN) {
+		c = gen_v(a->nat.v, n, NULL);
+	} else {
+		c = arr_v(VNAT, n);
+		for (size_t i=0; i<n; ++i) {
+			c->arr.v->v.nat[i] = a->nat.v + i;
+		}
+	}
+	free_v(a);
+	free_v(b);
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
+}
+static Ires 
+op_array(Env *e, Val *s, size_t p) {
+	/* rem: array (1, 2) packs a list of numbers of one type */
+	Val *a;
+	if (!set_prefix1_arg(e, s, p, &a, true)) {
+		return (Ires) {FAIL, s};
+	}
+	vtype t = homog_v(a);
+	if (!islst_v(a) || t == VNIL) {
+		free_v(a);
+		outf("? %s: argument not a list of numbers of one type\n", 
+				__FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	if (a->hdr.t == VLST) {
+		Val *b = pack_v(a, t);
+		free_v(a);
+		a = b;
+	}
+	upd_prefix1(s, p, a);
+	return (Ires) {OK, s};
+}
+static bool
+isvecarg_v(Val *a) {
+	/* list, array, vector, or () */
+	return islst_v(a) || a->hdr.t == VNIL;
+}
+static Ires 
+op_vector(Env *e, Val *s, size_t p) {
+	/* rem: vector (1, 2) is the list 1, 2 as a persistent vector */
+	Val *a;
+	if (!set_prefix1_arg(e, s, p, &a, true)) {
+		return (Ires) {FAIL, s};
+	}
+	if (!isvecarg_v(a)) {
+		free_v(a);
+		outf("? %s: argument not a list\n", 
+				__FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	Val *c = vec_v(a->hdr.t == VNIL ? NULL : vn_of(a));
+	free_v(a);
+	upd_prefix1(s, p, c);
+	return (Ires) {OK, s};
+}
+static Ires 
+add_elem(Env *e, Val *s, size_t p, bool pre, const char *fn) {
+	/* rem: append l x, and prepend l x, are vectors */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, true, &b, true)) {
+		return (Ires) {FAIL, s};
+	}
+	if (!isvecarg_v(a)) {
+		free_v(a);
+		free_v(b);
+		outf("? %s: first argument not a list\n", fn);
+		return (Ires) {FAIL, s};
+	}
+	Vnode *t = a->hdr.t == VNIL ? NULL : vn_of(a);
+	Vnode *x = vn_leaf(b);
+	Val *c = vec_v(pre ? vn_join(x, t) : vn_join(t, x));
+	vn_free(t);
+	vn_free(x);
+	free_v(a);
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
+}
+static Ires 
+op_append(Env *e, Val *s, size_t p) {
+	return add_elem(e, s, p, false, __FUNCTION__);
+}
+static Ires 
+op_prepend(Env *e, Val *s, size_t p) {
+	return add_elem(e, s, p, true, __FUNCTION__);
+}
+static Ires 
+op_concat(Env *e, Val *s, size_t p) {
+	/* rem: concat l m is the vector of l's then m's elements */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, true, &b, true)) {
+		return (Ires) {FAIL, s};
+	}
+	if (!isvecarg_v(a) || !isvecarg_v(b)) {
+		free_v(a);
+		free_v(b);
+		outf("? %s: arguments not lists\n", 
+				__FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	Vnode *l = a->hdr.t == VNIL ? NULL : vn_of(a);
+	Vnode *r = b->hdr.t == VNIL ? NULL : vn_of(b);
+	Val *c = vec_v(vn_join(l, r));
+	vn_free(l);
+	vn_free(r);
+	free_v(a);
+	free_v(b);
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
+}
+static bool
+index_ok(Val *a, Val *i, const char *fn) {
+	if (!islst_v(a) && a->hdr.t != VGEN) {
+		outf("? %s: first argument not a list\n", fn);
+		return false;
+	}
+	if (i->hdr.t != VNAT) {
+		outf("? %s: index not a natural number\n", fn);
+		return false;
+	}
+	if (i->nat.v < 0 || (size_t)i->nat.v >= len_v(a)) {
+		outf("? %s: index %lld out of range\n", fn, i->nat.v);
+		return false;
+	}
+	return true;
+}
+static Ires 
+op_at(Env *e, Val *s, size_t p) {
+	/* rem: at l 0 is the first element of l */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, true, &b, true)) {
+		return (Ires) {FAIL, s};
+	}
+	if (!index_ok(a, b, __FUNCTION__)) {
+		free_v(a);
+		free_v(b);
+		return (Ires) {FAIL, s};
+	}
+	Val tmp;
+	Val *c = a->hdr.t == VGEN ? gen_at(e, a, b->nat.v) 
+		: copy_v(elem_v(a, b->nat.v, &tmp));
+	free_v(a);
+	free_v(b);
+	if (c == NULL) {
+		return (Ires) {FAIL, s};
+	}
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
+}
+static Ires 
+op_set(Env *e, Val *s, size_t p) {
+	/* rem: set l i x is the vector l with x at i */
+	Val *a, *b, *c;
+	if (!set_prefix3_arg(e, s, p, &a, &b, &c)) {
+		return (Ires) {FAIL, s};
+	}
+	if (!index_ok(a, b, __FUNCTION__)) {
+		free_v(a);
+		free_v(b);
+		free_v(c);
+		return (Ires) {FAIL, s};
+	}
+	Vnode *t = vn_of(a);
+	Val *d = vec_v(vn_set(t, b->nat.v, c));
+	vn_free(t);
+	free_v(a);
+	free_v(b);
+	upd_prefix3(s, p, d);
+	return (Ires) {OK, s};
+}
+static Ires 
 op_call(Env *e, Val *s, size_t p) {
 	Val *a, *b;
 	if (!set_prefix2_arg(e, s, p, &a, true, &b, false)) {
 		return (Ires) {FAIL, s};
 	}
+	if (b->hdr.t == VSYM && e->cap != NULL
+			&& lookup_id(e, b->sym.v, false, NULL) != NULL) {
+		size_t id;
+		if (lookup_id(e, b->sym.v, false, &id) == NULL) {
+			/* captured by the running function: stands for its value */
+			Val *c = lookup(e, b->sym.v, false, false);
+			free_v(b);
+			b = copy_v(c);
+		}
+	}
 	if (b->hdr.t != VSYM) {
+		outf("? %s: name argument is not a symbol, got ", 
+				__FUNCTION__);
+		print_v(b, true); outf("\n");
 		free_v(a);
 		free_v(b);
-		printf("? %s: name argument is not a symbol, got ", 
-				__FUNCTION__);
-		print_v(b, true); printf("\n");
 		return (Ires) {FAIL, s};
 	}
 	Symval *sv = symval(b->sym.v, a);
@@ -1832,12 +3781,13 @@ op_true(Env *e, Val *s, size_t p) {
 	Val *a;
 	a = lookup(e, ITNAME, false, false);
 	if (a == NULL) {
-		printf("? %s: 'it undefined\n", 
+		outf("? %s: 'it undefined\n", 
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	Val *b = malloc(sizeof(*b));
 	b->hdr.t = VNAT;
+	b->hdr.lent = false;
 	b->nat.v = istrue_v(a);
 	upd_prefix0(s, p, b);
 	return (Ires) {OK, s};
@@ -1847,12 +3797,13 @@ op_false(Env *e, Val *s, size_t p) {
 	Val *a;
 	a = lookup(e, ITNAME, false, false);
 	if (a == NULL) {
-		printf("? %s: 'it undefined\n", 
+		outf("? %s: 'it undefined\n", 
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	Val *b = malloc(sizeof(*b));
 	b->hdr.t = VNAT;
+	b->hdr.lent = false;
 	b->nat.v = !istrue_v(a);
 	upd_prefix0(s, p, b);
 	return (Ires) {OK, s};
@@ -1860,7 +3811,7 @@ op_false(Env *e, Val *s, size_t p) {
 static Ires 
 op_if(Env *e, Val *s, size_t p) {
 	if (!(p == 0 && p == s->seq.v.n - 2)) {
-		printf("? %s: `if invalid syntax\n",
+		outf("? %s: `if invalid syntax\n",
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -1872,6 +3823,7 @@ op_if(Env *e, Val *s, size_t p) {
 	free_v(a);
 	a = malloc(sizeof(*a));
 	a->hdr.t = VNAT;
+	a->hdr.lent = false;
 	Ires rc;
 	if (c) {
 		a->nat.v = 1;
@@ -1897,12 +3849,13 @@ position(Val *a, List_v lv) {
 static Ires 
 op_else(Env *e, Val *s, size_t p) {
 	if (!(p == 0 && s->seq.v.n == 1)) {
-		printf("? %s: `else syntax incorrect\n", __FUNCTION__);
+		outf("? %s: `else syntax incorrect\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	if (e->state == IFSKIP) {
 		Val *a = malloc(sizeof(*a));
 		a->hdr.t = VNAT;
+		a->hdr.lent = false;
 		a->nat.v = 1;
 		upd_prefix0(s, p, a);
 		return (Ires) {OK, s};
@@ -1910,21 +3863,21 @@ op_else(Env *e, Val *s, size_t p) {
 	if (e->state == RUN) {
 		Val *it = lookup(e, ITNAME, false, false);
 		if (it == NULL) {
-			printf("? %s: `else before `if\n", __FUNCTION__);
+			outf("? %s: `else before `if\n", __FUNCTION__);
 			return (Ires) {FAIL, s};
 		} 
 		upd_prefix0(s, p, copy_v(it));
 		return (Ires) {SKIP, s};
 	}
-	printf("? %s: `else in invalid state ( ", __FUNCTION__);
+	outf("? %s: `else in invalid state ( ", __FUNCTION__);
 	print_istate(e->state);
-	printf(")\n");
+	outf(")\n");
 	return (Ires) {FAIL, s};
 }
 static Ires 
 op_rem(Env *e, Val *s, size_t p) {
 	if (p != 0) {
-		printf("? %s: `rem syntax invalid, needs to be 1st\n",
+		outf("? %s: `rem syntax invalid, needs to be 1st\n",
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -1932,6 +3885,7 @@ op_rem(Env *e, Val *s, size_t p) {
 	if (a == NULL) {
 		Val *b = malloc(sizeof(*b));
 		b->hdr.t = VNIL;
+		b->hdr.lent = false;
 		upd_prefixall(s, p, b);
 	} else {
 		upd_prefixall(s, p, copy_v(a));
@@ -1942,7 +3896,7 @@ static Ires
 op_def(Env *e, Val *s, size_t p) {
 	/* rem: define foo (a, b) or define foo () ; */
 	if (s->seq.v.n != 3 || p != 0) {
-		printf("? %s: incorrect syntax for `define (expecting: def name list)\n",
+		outf("? %s: incorrect syntax for `define (expecting: def name list)\n",
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -1951,15 +3905,15 @@ op_def(Env *e, Val *s, size_t p) {
 		return (Ires) {FAIL, s};
 	}
 	if (fname->hdr.t != VSYM) {
-		printf("? %s: expecting symbol for function name, got ",
+		outf("? %s: expecting symbol for function name, got ",
 				__FUNCTION__);
-		print_v(fname, true); printf("\n");
+		print_v(fname, true); outf("\n");
 		free_v(fname);
 		free_v(fparam);
 		return (Ires) {FAIL, s};
 	}
 	if (!(fparam->hdr.t == VLST || fparam->hdr.t == VNIL)) {
-		printf("? %s: expecting list or '()' for function parameters\n",
+		outf("? %s: expecting list or '()' for function parameters\n",
 				__FUNCTION__);
 		free_v(fname);
 		free_v(fparam);
@@ -1968,7 +3922,7 @@ op_def(Env *e, Val *s, size_t p) {
 	if (fparam->hdr.t == VLST) {
 		for (size_t i=0; i < fparam->lst.v.n; ++i) {
 			if (fparam->lst.v.v[i]->hdr.t != VSYM) {
-				printf("? %s: expecting symbol for function parameter\n",
+				outf("? %s: expecting symbol for function parameter\n",
 						__FUNCTION__);
 				free_v(fname);
 				free_v(fparam);
@@ -1993,15 +3947,16 @@ op_def(Env *e, Val *s, size_t p) {
 	free_v(fparam);
 	f->symf.body.n = 0;
 	f->symf.body.v = NULL;
+	f->symf.cap = NULL;
+	f->symf.code = NULL;
 	upd_prefix2(s, p, f);
 	return (Ires) {DEF, s};
 }
 static Ires
 op_loop(Env *e, Val *s, size_t p) {
-	if (Dbg) { printf("#\t  %s %5s: ", __FUNCTION__, "entry"); printx_v(s,false,"#\t"); printf("\n"); }
 	/* rem: loop */
 	if (s->seq.v.n != 1) {
-		printf("? %s: `loop does not take arguments\n",
+		outf("? %s: `loop does not take arguments\n",
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -2012,15 +3967,16 @@ op_loop(Env *e, Val *s, size_t p) {
 	f->symf.param.v = NULL;
 	f->symf.body.n = 0;
 	f->symf.body.v = NULL;
+	f->symf.cap = NULL;
+	f->symf.code = NULL;
 	upd_prefix0(s, p, f);
 	return (Ires) {LOOP, s};
 }
 static Ires 
 op_end(Env *e, Val *s, size_t p) {
-	if (Dbg) { printf("#\t  %s %5s: ", __FUNCTION__, "entry"); printx_v(s, false, ""); printf("\n"); }
 	/* rem: end somefun or end if or end loop ; */
 	if (p != 0 || s->seq.v.n != 2) {
-		printf("? %s: invalid syntax for `end, expecting an argument\n",
+		outf("? %s: invalid syntax for `end, expecting an argument\n",
 				__FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
@@ -2034,7 +3990,7 @@ op_end(Env *e, Val *s, size_t p) {
 		if (a->symop.v == op_if || a->symop.v == op_loop) {
 			Val *c = lookup(e, ITNAME, false, false);
 			if (c == NULL) {
-				printf("? %s: 'it undefined, missing `if or `loop?\n",
+				outf("? %s: 'it undefined, missing `if or `loop?\n",
 						__FUNCTION__);
 				free_v(a);
 				return (Ires) {FAIL, s};
@@ -2042,7 +3998,7 @@ op_end(Env *e, Val *s, size_t p) {
 			free_v(a);
 			b = copy_v(c);
 		} else {
-			printf("? %s: `end with wrong operator argument (expecting `if or `loop)\n",
+			outf("? %s: `end with wrong operator argument (expecting `if or `loop)\n",
 					__FUNCTION__);
 			free_v(a);
 			return (Ires) {FAIL, s};
@@ -2050,14 +4006,14 @@ op_end(Env *e, Val *s, size_t p) {
 	} else if (a->hdr.t == VSYM) {
 		/* rem: end function ? */
 		if (e->state != FUNDEF) {
-			printf("? %s: `end outside function definition\n", 
+			outf("? %s: `end outside function definition\n", 
 					__FUNCTION__);
 			free_v(a);
 			return (Ires) {FAIL, s};
 		}
 		Val *c = lookup(e, ITNAME, false, false);
 		if (c == NULL) {
-			printf("? %s: 'it missing\n", 
+			outf("? %s: 'it missing\n", 
 					__FUNCTION__);
 			free_v(a);
 			return (Ires) {FAIL, s};
@@ -2072,7 +4028,9 @@ op_end(Env *e, Val *s, size_t p) {
 			return (Ires) {BACK, s};
 		}
 		free_v(a);
-		/* rem: end 'fun : add the fun symbol */
+		/* rem: end 'fun : add the fun symbol, its body compiled */
+		free_code(c->symf.code);
+		c->symf.code = code_of(c->symf.body);
 		Symval *sv = symval(c->symf.name, c);
 		if (!stored_sym(e, sv)) {
 			free_symval(sv);
@@ -2080,7 +4038,7 @@ op_end(Env *e, Val *s, size_t p) {
 		}
 		b = copy_v(c);
 	} else {
-		printf("? %s: `end with wrong argument type\n",
+		outf("? %s: `end with wrong argument type\n",
 				__FUNCTION__);
 		free_v(a);
 		return (Ires) {FAIL, s};
@@ -2089,16 +4047,20 @@ op_end(Env *e, Val *s, size_t p) {
 	return (Ires) {OK, s};
 }
 /* --- reduce (user) function application --- */
-Env *
+static Env *
 new_env(Env *parent) {
 	Env *e = malloc(sizeof(*e));
 	assert(e != NULL);
 	e->state = RUN;
 	e->n = 0;
 	e->s = NULL;
+	e->loops = 0;
+	e->cap = NULL;
 	e->parent = parent;
+	e->id = __atomic_add_fetch(&Envids, 1, __ATOMIC_RELAXED);
 	Val *it = malloc(sizeof(*it));
 	it->hdr.t = VNIL;
+	it->hdr.lent = false;
 	Symval *svit = symval(ITNAME, it);
 	free_v(it);
 	if (svit == NULL) {
@@ -2112,6 +4074,7 @@ new_env(Env *parent) {
 	}
 	Val *lnst = malloc(sizeof(*lnst));
 	lnst->hdr.t = VNAT;
+	lnst->hdr.lent = false;
 	lnst->nat.v = 0;
 	Symval *lv = symval(LOOPNEST, lnst);
 	free_v(lnst);
@@ -2127,49 +4090,199 @@ new_env(Env *parent) {
 	return e;
 }
 
+/* ------------ limits of a phrase: fuel, time, calls --------- */
+
+/* nested function calls, about half of what 8MB of stack allows */
+#define MAXDEPTH 5000
+
+typedef enum { LNONE, LFUEL, LTIME, LSIG, LDEPTH } limit;
+
+/* the limits of a context and its running phrase, 
+ * shared by the threads it uses */
+typedef struct {
+	size_t fuel;	/* steps allowed per phrase, 0 for no limit */
+	long timeout;	/* milliseconds allowed per phrase, 0 for no limit */
+	size_t maxdepth;	/* nested function calls allowed */
+	int stop;	/* limit hit */
+	size_t steps;	/* taken, all threads */
+	uint64_t deadline;	/* in ns, if timeout */
+	unsigned intrs;	/* interruptions when it began */
+} Limits;
+
+/* the clock is read once per that many steps */
+#define TIMESTEPS 1024
+
+static size_t Maxdepth = MAXDEPTH;	/* of new contexts */
+static Limits Mainlimits = {.maxdepth = MAXDEPTH};
+static __thread Limits *Lim = &Mainlimits;	/* of the context evaluating */
+static unsigned Intrs;	/* SIGINT received */
+static int Running;	/* phrases evaluated */
+static __thread size_t Depth;	/* of run_fun calls, in this thread */
+
+static void
+limits_init(Limits *a) {
+	/* those of new contexts, nothing running */
+	memset(a, 0, sizeof(*a));
+	a->fuel = Fuel;
+	a->timeout = Timeout;
+	a->maxdepth = Maxdepth;
+}
+static void
+stop_for(limit l) {
+	/* the running phrase must end, for the first limit hit */
+	int none = LNONE;
+	__atomic_compare_exchange_n(&Lim->stop, &none, l, false, 
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+static bool
+stopped(void) {
+	/* one step more, true if the running phrase must end */
+	Limits *l = Lim;
+	if (l->fuel > 0 || l->timeout > 0) {
+		size_t n = __atomic_add_fetch(&l->steps, 1, __ATOMIC_RELAXED);
+		if (l->fuel > 0 && n > l->fuel) {
+			stop_for(LFUEL);
+		}
+		if (l->timeout > 0 && n % TIMESTEPS == 0 && now_ns() > l->deadline) {
+			stop_for(LTIME);
+		}
+	}
+	if (__atomic_load_n(&Intrs, __ATOMIC_RELAXED) != l->intrs) {
+		stop_for(LSIG);
+	}
+	return __atomic_load_n(&l->stop, __ATOMIC_RELAXED) != LNONE;
+}
+static bool
+limits_now(void) {
+	/* true if the running phrase must end, the clock read now */
+	Limits *l = Lim;
+	if (l->timeout > 0 && now_ns() > l->deadline) {
+		stop_for(LTIME);
+	}
+	if (__atomic_load_n(&Intrs, __ATOMIC_RELAXED) != l->intrs) {
+		stop_for(LSIG);
+	}
+	return __atomic_load_n(&l->stop, __ATOMIC_RELAXED) != LNONE;
+}
+static void
+phrase_begin(void) {
+	/* limits for the phrase about to run */
+	Limits *l = Lim;
+	__atomic_store_n(&l->steps, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&l->stop, LNONE, __ATOMIC_RELAXED);
+	l->intrs = __atomic_load_n(&Intrs, __ATOMIC_RELAXED);
+	if (l->timeout > 0) {
+		l->deadline = now_ns() + (uint64_t)l->timeout * 1000000;
+	}
+	__atomic_add_fetch(&Running, 1, __ATOMIC_RELAXED);
+}
+static bool
+phrase_end(void) {
+	/* false if the phrase hit a limit, reported */
+	__atomic_sub_fetch(&Running, 1, __ATOMIC_RELAXED);
+	limit l = __atomic_load_n(&Lim->stop, __ATOMIC_RELAXED);
+	switch (l) {
+		case LNONE:
+			return true;
+		case LFUEL:
+			outf("? %s: phrase abandoned, out of fuel (%lu steps)\n", "main", Lim->fuel);
+			break;
+		case LTIME:
+			outf("? %s: phrase abandoned, out of time (%ld ms)\n", "main", Lim->timeout);
+			break;
+		case LSIG:
+			outf("? %s: phrase abandoned, interrupted\n", "main");
+			break;
+		case LDEPTH:
+			outf("? %s: phrase abandoned, calls too deep (%lu)\n", "main", Lim->maxdepth);
+			break;
+	}
+	return false;
+}
+
+static Val *
+run_fun(Env *le, Val *f) {
+	/* reduce each expression in f's body in local env le, like eval_ph,
+	 * returns a copy of the local 'it, or NULL on failure */
+	if (++Depth > Lim->maxdepth) {
+		--Depth;
+		stop_for(LDEPTH);
+		return NULL;
+	}
+	bool ok = run_body(le, f, false);
+	--Depth;
+	if (!ok) {
+		return NULL;
+	}
+	/* return local (function's) 'it to caller */
+	Val *lit = lookup(le, ITNAME, false, true);
+	if (lit == NULL) {
+		outf("? %s: 'it from `%s undefined\n",
+				__FUNCTION__, f->symf.name);
+		return NULL;
+	}
+	return copy_v(lit);
+}
+
 static Ires 
 apply_fun(Env *e, Val *s, size_t p) {
 	/* rem: ... foo (1, 2) or foo () ... */
 	Val *al;
 	Val *f = s->seq.v.v[p];
 	if (!set_prefix1_arg(e, s, p, &al, true)) {
-		printf("? %s: invalid argument to `%s\n", 
+		outf("? %s: invalid argument to `%s\n", 
 				__FUNCTION__, f->symf.name);
 		return (Ires) {FAIL, s};
 	}
+	if (al->hdr.t == VARR || al->hdr.t == VVEC) {
+		Val *b = unpack_v(al);
+		free_v(al);
+		al = b;
+	}
 	if (!(al->hdr.t == VLST || al->hdr.t == VNIL)) {
-		printf("? %s: argument to `%s not a list or '()'\n", 
+		outf("? %s: argument to `%s not a list or '()'\n", 
 				__FUNCTION__, f->symf.name);
 		free_v(al);
 		return (Ires) {FAIL, s};
 	}
 	if (al->hdr.t == VNIL && f->symf.param.n != 0) {
-		printf("? %s: expected %lu argument(s) to `%s\n", 
+		outf("? %s: expected %lu argument(s) to `%s\n", 
 				__FUNCTION__, f->symf.param.n, f->symf.name);
 		free_v(al);
 		return (Ires) {FAIL, s};
 	}
 	if (al->hdr.t == VLST && al->lst.v.n != f->symf.param.n) {
-		printf("? %s: number of arguments to `%s mismatch (got %lu, expected %lu)\n", 
+		outf("? %s: number of arguments to `%s mismatch (got %lu, expected %lu)\n", 
 				__FUNCTION__, f->symf.name,
 				al->lst.v.n, f->symf.param.n);
 		free_v(al);
 		return (Ires) {FAIL, s};
 	}
+	if (al->hdr.t == VLST) {
+		Ires rc = solve_lst(e, al, true, true);
+		if (rc.code != OK) {
+			free_v(al);
+			return (Ires) {FAIL, s};
+		}
+	}
+	Val *r;
+	if (Jit && jit_call(e, f, al->hdr.t == VLST ? al->lst.v.v : NULL, &r)) {
+		if (Trace & EVCALL) { trace_ev(EVCALL, 1, f->symf.param.n, e->id, f->symf.name); }
+		free_v(al);
+		upd_prefix1(s, p, r);
+		return (Ires) {OK, s};
+	}
 	/* setup local env */
 	Env *le = new_env(e);
+	if ((Trace & EVCALL) && le != NULL) { trace_ev(EVCALL, 0, f->symf.param.n, le->id, f->symf.name); }
 	if (le == NULL) {
-		printf("? %s: local env creation failed\n",
+		outf("? %s: local env creation failed\n",
 				__FUNCTION__);
 		free_v(al);
 		return (Ires) {FAIL, s};
 	}
+	le->cap = ref_frame(f->symf.cap);
 	if (al->hdr.t == VLST) {
-		Ires rc = solve_lst(e, al, true, true);
-		if (rc.code != OK) {
-			free_v(al);
-			return (Ires) {FAIL, s};
-		}
 		/* add parameters in local env, value is al's */
 		for (size_t i=0; i<f->symf.param.n; ++i) {
 			Symval *sv = symval(f->symf.param.v[i]->sym.v, al->lst.v.v[i]);
@@ -2182,50 +4295,28 @@ apply_fun(Env *e, Val *s, size_t p) {
 		}
 	}
 	free_v(al);
-	/* reduce each expression in body, like eval_ph: */
-	Val *v;
-	bool t; /* transition successful */
-	for (size_t i=0; i<f->symf.body.n; ++i) {
-		v = copy_v(f->symf.body.v[i]);
-		if (Dbg) { printf("#\t  %s %5s: ", __FUNCTION__, "value"); printx_v(v,false,"#\t"); printf("\n"); }
-		t = transition(le, v); /* consumes v */
-		if (Dbg) { printf("#\t  %s %5s: ", __FUNCTION__, "reduce"); print_istate(le->state); printf("\n"); } 
-		if (!t) {
-			free_env(le, false);
-			return (Ires) {FAIL, s};
-		}
-		if (le->state == RETURN) {
-			break;
-		}
-	}
-	if (Dbg) { printf("#\t  %s %5s:\n", __FUNCTION__, "done"); print_env(le, "#\t"); }
-	/* return local (function's) 'it to caller */
-	char *sym = ITNAME;
-	Val *lit = lookup(le, sym, false, true);
-	if (lit == NULL) {
-		printf("? %s: 'it from `%s undefined\n",
-				__FUNCTION__, f->symf.name);
-		free_env(le, false);
+	r = run_fun(le, f);
+	free_env(le, false);
+	if (r == NULL) {
 		return (Ires) {FAIL, s};
 	}
-	upd_prefix1(s, p, copy_v(lit));
-	free_env(le, false);
+	upd_prefix1(s, p, r);
 	return (Ires) {OK, s};
 }
 static Ires 
 op_return(Env *e, Val *s, size_t p) {
 	if (!(p == 0 && s->seq.v.n == 1)) {
-		printf("? %s: `return syntax incorrect\n", __FUNCTION__);
+		outf("? %s: `return syntax incorrect\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
-	/* return only from a function call */
-	if (e->parent == NULL) {
-		printf("? %s: `return outside function\n", __FUNCTION__);
+	/* return only from a function call (or a loop, that ends) */
+	if (e->parent == NULL && e->loops == 0) {
+		outf("? %s: `return outside function\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	Val *it = lookup(e, ITNAME, false, true);
 	if (it == NULL) {
-		printf("? %s: 'it undefined\n", __FUNCTION__);
+		outf("? %s: 'it undefined\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	upd_prefix0(s, p, copy_v(it));
@@ -2234,12 +4325,12 @@ op_return(Env *e, Val *s, size_t p) {
 static Ires 
 op_stop(Env *e, Val *s, size_t p) {
 	if (!(p == 0 && s->seq.v.n == 1)) {
-		printf("? %s: `stop syntax incorrect\n", __FUNCTION__);
+		outf("? %s: `stop syntax incorrect\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	Val *it = lookup(e, ITNAME, false, false);
 	if (it == NULL) {
-		printf("? %s: 'it undefined (`stop return value)\n", __FUNCTION__);
+		outf("? %s: 'it undefined (`stop return value)\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	upd_prefix0(s, p, copy_v(it));
@@ -2248,869 +4339,4063 @@ op_stop(Env *e, Val *s, size_t p) {
 static Ires 
 op_env(Env *e, Val *s, size_t p) {
 	if (!(p == 0 && s->seq.v.n == 1)) {
-		printf("? %s: `env syntax incorrect\n", __FUNCTION__);
+		outf("? %s: `env syntax incorrect\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	print_env(e, ">");
 	Val *it = lookup(e, ITNAME, false, false);
 	if (it == NULL) {
-		printf("? %s: 'it undefined\n", __FUNCTION__);
+		outf("? %s: 'it undefined\n", __FUNCTION__);
 		return (Ires) {FAIL, s};
 	}
 	upd_prefix0(s, p, copy_v(it));
 	return (Ires) {OK, s}; /* TODO: optim, return NOP, NULL */
 }
 
-/* --------------- builtin or base function symbols -------------------- */
-
-/* user defined fun priority */
-#define FUNDEFPRIO 0
-
-typedef struct Symop_ {
-	char name[WSZ];
-	int prio;
-	Ires (*f)(Env *e, Val *s, size_t p);
-	int arity;
-} Symop;
+static Ires 
+op_save_image(Env *e, Val *s, size_t p) {
+	/* the path is taken as written, not looked up, 
+	 * gives the number of symbols saved */
+	Val *a;
+	if (!set_prefix1_arg(e, s, p, &a, false)) {
+		return (Ires) {FAIL, s};
+	}
+	if (a->hdr.t != VSYM) {
+		outf("? %s: path is not a symbol, got ", __FUNCTION__);
+		print_v(a, true); outf("\n");
+		free_v(a);
+		return (Ires) {FAIL, s};
+	}
+	long long n = save_image(e, a->sym.v);
+	free_v(a);
+	if (n < 0) {
+		return (Ires) {FAIL, s};
+	}
+	a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->hdr.t = VNAT;
+	a->hdr.lent = false;
+	a->nat.v = n;
+	upd_prefix1(s, p, a);
+	return (Ires) {OK, s};
+}
 
-Symop Syms[] = {
-	(Symop) {"call",   -20, op_call,   2},
-	(Symop) {"define", -20, op_def,    2},
-	(Symop) {"def",    -20, op_def,    2},
-	(Symop) {"do",     -20, op_do,     1},
-	(Symop) {"else",   -20, op_else,   0},
-	(Symop) {"end",    -20, op_end,    1}, /* needs to be prior to loop, if, ufun */
-	(Symop) {"env",    -20, op_env,    0},
-	(Symop) {"list",   -20, op_list,  -1},
-	(Symop) {"loop",   -20, op_loop,   0},
-	(Symop) {"print",  -20, op_print,  1}, 
-	(Symop) {"rem:",   -20, op_rem,   -1}, /* -1 arity: remainder of seq val */
-	(Symop) {"return", -20, op_return, 0},
-	(Symop) {"stop",   -20, op_stop,   0},
-	(Symop) {"solve",  -20, op_solve,  1},
-	(Symop) {"true?",  -20, op_true,   0},
-	(Symop) {"false?", -20, op_false,  0},
-	(Symop) {"=",      -10, op_eq,  2},
-	(Symop) {"/=",     -10, op_neq, 2},
-	(Symop) {"<",    40, op_les, 2},
-	(Symop) {"<=",   40, op_leq, 2},
-	(Symop) {">",    40, op_gre, 2},
-	(Symop) {">=",   40, op_geq, 2},
-	(Symop) {"~=",   40, op_eqv, 2},
-	/* priority FUNDEFPRIO (0) is for function (user defined) */
-	(Symop) {"*",    20, op_mul, 2},
-	(Symop) {"/",    20, op_div, 2},
-	(Symop) {"+",    30, op_plu, 2},
-	(Symop) {"-",    30, op_min, 2},
-	/* (Symop) {"=",    40, op_eq,  2}, */
-	(Symop) {"not",  50, op_not, 1},
-	(Symop) {"and",  60, op_and, 2},
-	(Symop) {"or",   70, op_or,  2},
-	(Symop) {"if",   80, op_if,  1},
-	(Symop) {"",      0, op_false, -1},
-};
-static int
-minprio() {
-	int m = 0;
-	for (int i=0; Syms[i].name[0] != '\0'; ++i) {
-		if (Syms[i].prio > m) {
-			m = Syms[i].prio;
+/* raw arrays: files of 8 bytes numbers (long long or double), 
+ * in the host's order (little-endian), without header */
+static Val *
+map_arr(const char *path, vtype t) {
+	/* array of the numbers of type t in the file at path, mapped 
+	 * read-only: not copied, its pages read as they are used */
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		outf("? %s: %s: %s\n", __FUNCTION__, path, strerror(errno));
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size % 8 != 0) {
+		outf("? %s: %s: not a file of 8 bytes numbers\n", __FUNCTION__, path);
+		close(fd);
+		return NULL;
+	}
+	Val *c = arr_v(t, 0);
+	if (st.st_size > 0) {
+		void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			outf("? %s: %s: %s\n", __FUNCTION__, path, strerror(errno));
+			close(fd);
+			free_v(c);
+			return NULL;
 		}
+		madvise(m, st.st_size, MADV_SEQUENTIAL);
+		c->arr.v->map = m;
+		c->arr.v->len = st.st_size;
+		c->arr.v->n = st.st_size / 8;
+		c->arr.v->v.nat = m;
 	}
-	return m;
+	close(fd);
+	return c;
 }
-static Symop *
-lookup_op(char *a) {
-	for (size_t i=0; Syms[i].name[0] != '\0'; ++i) {
-		Symop *b = Syms+i;
-		if (strncmp(b->name, a, sizeof(b->name)) == 0) {
-			return b;
+static Ires 
+op_load_array(Env *e, Val *s, size_t p) {
+	/* rem: load-array data.bin real is the array of the file's numbers, 
+	 * path and type taken as written */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, false, &b, false)) {
+		return (Ires) {FAIL, s};
+	}
+	vtype t = VNIL;
+	if (b->hdr.t == VSYM && strcmp(b->sym.v, "nat") == 0) {
+		t = VNAT;
+	} else if (b->hdr.t == VSYM && strcmp(b->sym.v, "real") == 0) {
+		t = VREA;
+	}
+	if (a->hdr.t != VSYM || t == VNIL) {
+		outf("? %s: arguments not a path and nat or real\n", __FUNCTION__);
+		free_v(a);
+		free_v(b);
+		return (Ires) {FAIL, s};
+	}
+	Val *c = map_arr(a->sym.v, t);
+	free_v(a);
+	free_v(b);
+	if (c == NULL) {
+		return (Ires) {FAIL, s};
+	}
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
+}
+static Ires 
+op_save_array(Env *e, Val *s, size_t p) {
+	/* rem: save-array data.bin (1, 2) writes the numbers (of one type), 
+	 * aside then renamed in place, gives their number */
+	Val *a, *b;
+	if (!set_prefix2_arg(e, s, p, &a, false, &b, true)) {
+		return (Ires) {FAIL, s};
+	}
+	vtype t = b->hdr.t == VARR ? b->arr.v->t : homog_v(b);
+	if (a->hdr.t != VSYM || !islst_v(b) || t == VNIL) {
+		outf("? %s: arguments not a path and a list of numbers of one type\n", 
+				__FUNCTION__);
+		free_v(a);
+		free_v(b);
+		return (Ires) {FAIL, s};
+	}
+	if (b->hdr.t == VLST) {
+		Val *c = pack_v(b, t);
+		free_v(b);
+		b = c;
+	}
+	char tmp[PATH_MAX];
+	size_t n = b->arr.v->n;
+	bool ok = snprintf(tmp, sizeof(tmp), "%s.%ld", a->sym.v, (long)getpid()) < (int)sizeof(tmp);
+	FILE *f = ok ? fopen(tmp, "wb") : NULL;
+	if (f != NULL) {
+		ok = n == 0 || fwrite(b->arr.v->v.nat, 8, n, f) == n;
+		ok = (fclose(f) == 0) && ok;
+		if (!ok || rename(tmp, a->sym.v) != 0) {
+			ok = false;
+			remove(tmp);
 		}
 	}
-	return NULL;
+	if (!ok || f == NULL) {
+		outf("? %s: %s: %s\n", __FUNCTION__, a->sym.v, strerror(errno));
+		free_v(a);
+		free_v(b);
+		return (Ires) {FAIL, s};
+	}
+	free_v(a);
+	free_v(b);
+	Val *c = malloc(sizeof(*c));
+	assert(c != NULL);
+	c->hdr.t = VNAT;
+	c->hdr.lent = false;
+	c->nat.v = n;
+	upd_prefix2(s, p, c);
+	return (Ires) {OK, s};
 }
 
-/* --------------- user defined value symbols -------------------- */
+/* --- native iteration: map, filter, fold --- 
+ * a user function gets a single local env, reset between elements,
+ * an operator is applied to a small seq built per element.
+ */
 
+typedef struct {
+	Val *f;		/* VFUN or VOPE, borrowed */
+	Env *le;	/* VFUN local env */
+	size_t n;	/* symbols in le once set up */
+} Iter;
 
 static bool
-isatom_v(Val *a) {
-	assert(a != NULL);
-	return (a->hdr.t == VNIL 
-			|| a->hdr.t == VNAT 
-			|| a->hdr.t == VREA
-			|| a->hdr.t == VSYM
-			|| a->hdr.t == VFUN
-			|| a->hdr.t == VOPE);
-}
-
-static Val *
-val_of_seme(Env *e, Sem *s) {
-	/* returns fresh value, 's untouched */
-	assert(s != NULL && "seme null");
-	Val *a = NULL;
-	if (s->hdr.t == SNIL ) {
-		a = malloc(sizeof(*a));
-		a->hdr.t = VNIL;
-		return a;
+iter_init(Iter *a, Env *e, Val *f, size_t arity, const char *fn) {
+	a->f = f;
+	a->le = NULL;
+	if (f->hdr.t == VOPE) {
+		if (f->symop.arity != arity) {
+			outf("? %s: `%s does not take %lu argument(s)\n",
+					fn, f->symop.name, arity);
+			return false;
+		}
+		return true;
 	}
-	if (s->hdr.t == SNAT) {
-		a = malloc(sizeof(*a));
-		a->hdr.t = VNAT;
-		a->nat.v = s->nat.v;
-		return a;
+	if (f->hdr.t != VFUN) {
+		outf("? %s: first argument not a function\n", fn);
+		return false;
 	}
-	if (s->hdr.t == SREA) {
-		a = malloc(sizeof(*a));
-		a->hdr.t = VREA;
-		a->rea.v = s->rea.v;
-		return a;
+	if (f->symf.param.n != arity) {
+		outf("? %s: `%s expects %lu argument(s), not %lu\n",
+				fn, f->symf.name, f->symf.param.n, arity);
+		return false;
 	}
-	if (s->hdr.t == SSYM) {
-		a = malloc(sizeof(*a));
-		assert(a != NULL);
-		a->hdr.t = VSYM;
-		strncpy(a->sym.v, s->sym.v, 1+strlen(s->sym.v));
-		return a;
+	a->le = new_env(e);
+	if (a->le == NULL) {
+		outf("? %s: local env creation failed\n", fn);
+		return false;
 	}
-	if (s->hdr.t == SLST) {
-		size_t n = s->lst.v.n;
-		Sem *l = s->lst.v.s;
-		Val *d;
-		for (size_t i=0; i<n; ++i) {
-			d = val_of_seme(e, l+i);
-			if (d == NULL) {
-				free_v(a);
-				return NULL;
+	a->le->cap = ref_frame(f->symf.cap);
+	Val nil;
+	nil.hdr.t = VNIL;
+	for (size_t i=0; i<arity; ++i) {
+		Symval *sv = symval(f->symf.param.v[i]->sym.v, &nil);
+		if (sv == NULL || !stored_sym(a->le, sv)) {
+			if (sv != NULL) {
+				free_symval(sv);
 			}
-			a = push_v(VLST, a, d);
+			free_env(a->le, false);
+			a->le = NULL;
+			return false;
 		}
-		return a;
 	}
-	if (s->hdr.t == SSEQ) {
-		size_t n = s->seq.v.n;
-		Sem *l = s->seq.v.s;
-		Val *d;
-		for (size_t i=0; i<n; ++i) {
-			d = val_of_seme(e, l+i);
-			if (d == NULL) {
-				free_v(a);
-				return NULL;
+	a->n = a->le->n;
+	return true;
+}
+static void
+iter_free(Iter *a) {
+	free_env(a->le, false);
+	a->le = NULL;
+}
+static void
+set_symval(Env *e, char *name, Val *v) {
+	/* replace value of name, known to be in e, v is consumed */
+	size_t id;
+	Symval *sv = lookup_id(e, name, false, &id);
+	assert(sv != NULL);
+	sv = own_sym(e, id);
+	free_v(sv->v);
+	sv->v = v;
+}
+static Val *
+iter_call(Iter *a, Env *e, Val **args) {
+	/* a->f applied to args (left untouched), returns a fresh value */
+	Val *f = a->f;
+	if (f->hdr.t == VOPE) {
+		Val *s = NULL;
+		if (f->symop.arity == 2) {
+			s = push_v(VSEQ, s, copy_v(args[0]));
+			s = push_v(VSEQ, s, copy_v(f));
+			s = push_v(VSEQ, s, copy_v(args[1]));
+		} else {
+			s = push_v(VSEQ, s, copy_v(f));
+			for (size_t i=0; i<f->symop.arity; ++i) {
+				s = push_v(VSEQ, s, copy_v(args[i]));
 			}
-			a = push_v(VSEQ, a, d);
 		}
-		return a;
+		Ires rc = reduce_seq(e, s);
+		if (rc.code != OK || s->seq.v.n != 1) {
+			free_v(s);
+			return NULL;
+		}
+		Val *r = s->seq.v.v[0];
+		s->seq.v.n = 0;
+		free_v(s);
+		return r;
 	}
-	printf("? %s: unknown seme\n",
-			__FUNCTION__);
-	return NULL;
+	Val *r;
+	if (Jit && jit_call(e, f, args, &r)) {
+		if (Trace & EVCALL) { trace_ev(EVCALL, 1, f->symf.param.n, e->id, f->symf.name); }
+		return r;
+	}
+	if (Trace & EVCALL) { trace_ev(EVCALL, 0, f->symf.param.n, a->le->id, f->symf.name); }
+	/* reset local env as new, then bind parameters */
+	Env *le = a->le;
+	for (size_t i=a->n; i<le->n; ++i) {
+		bump_sym(le->s[i]->name);
+		free_symval(le->s[i]);
+	}
+	le->n = a->n;
+	le->state = RUN;
+	Val *v = malloc(sizeof(*v));
+	v->hdr.t = VNIL;
+	v->hdr.lent = false;
+	set_symval(le, ITNAME, v);
+	v = malloc(sizeof(*v));
+	v->hdr.t = VNAT;
+	v->hdr.lent = false;
+	v->nat.v = 0;
+	set_symval(le, LOOPNEST, v);
+	for (size_t i=0; i<f->symf.param.n; ++i) {
+		set_symval(le, f->symf.param.v[i]->sym.v, copy_v(args[i]));
+	}
+	return run_fun(le, f);
+}
+static Val *
+iter_arg(Env *e, Val *l, size_t i, Val *tmp) {
+	/* i-th element of l, solved like function arguments, fresh */
+	if (l->hdr.t == VGEN) {
+		return gen_at(e, l, i);
+	}
+	Val *c = copy_v(elem_v(l, i, tmp));
+	if (c->hdr.t != VSYM && c->hdr.t != VSEQ) {
+		return c;
+	}
+	Ires rc = eval_run(e, c, true, true);
+	if (!(rc.code == OK || rc.code == NOP)) {
+		return NULL;
+	}
+	return rc.v;
+}
+static Val *
+lst_of_vals(Val **v, size_t n) {
+	/* list from n fresh values (stolen), packed if numbers of one type */
+	Val *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->hdr.t = VLST;
+	a->lst.h = 0;
+	a->lst.v.n = n;
+	a->lst.v.v = v;
+	vtype t = homog_v(a);
+	if (n >= PACKMIN && t != VNIL) {
+		Val *b = pack_v(a, t);
+		free_v(a);
+		return b;
+	}
+	return a;
+}
+static bool
+iter_check(Val *l, const char *fn) {
+	if (!islst_v(l) && l->hdr.t != VGEN) {
+		outf("? %s: argument not a list\n", fn);
+		return false;
+	}
+	return true;
 }
-
-/* ----- evaluation, pass 2, symbolic computation ----- */
 
 static Ires 
-solve_fun(Env *e, Val *a) {
-	/* works on SEQ and LST */
-	assert(a->hdr.t == VSEQ || a->hdr.t == VLST);
-	Val *b = NULL;
-	for (size_t i=0; i < a->seq.v.n; ++i) {
-		b = a->seq.v.v[i];
-		if (b->hdr.t == VSYM) {
-			Val *c = NULL;
-			Symop *so = lookup_op(b->sym.v);
-			if (so != NULL) {
-				c = malloc(sizeof(*c));
-				c->hdr.t = VOPE;
-				c->symop.prio = so->prio;
-				c->symop.v = so->f;
-				c->symop.arity = so->arity;
-				strncpy(c->symop.name, so->name, 1+strlen(so->name));
-				free_v(b);
-				a->seq.v.v[i] = c;
-				continue;
-			}
-			if (strncmp(b->sym.v, IT, sizeof(b->sym.v)) == 0) {
-				/* 'it is resolved at exec */
-				continue;
+op_map(Env *e, Val *s, size_t p) {
+	/* rem: map f (1, 2) is f (1,), f (2,) */
+	Val *f, *l;
+	if (!set_prefix2_arg(e, s, p, &f, true, &l, true)) {
+		return (Ires) {FAIL, s};
+	}
+	Iter it;
+	if (!iter_check(l, __FUNCTION__) || !iter_init(&it, e, f, 1, __FUNCTION__)) {
+		free_v(f);
+		free_v(l);
+		return (Ires) {FAIL, s};
+	}
+	size_t n = len_v(l);
+	Val **r = malloc(n * sizeof(Val*));
+	assert(n == 0 || r != NULL);
+	Val tmp;
+	for (size_t i=0; i<n; ++i) {
+		Val *x = iter_arg(e, l, i, &tmp);
+		r[i] = x == NULL ? NULL : iter_call(&it, e, &x);
+		free_v(x);
+		if (r[i] == NULL) {
+			for (size_t j=0; j<i; ++j) {
+				free_v(r[j]);
 			}
-			c = lookup(e, b->sym.v, true, true);
-			if (c != NULL && (c->hdr.t == VFUN
-					|| c->hdr.t == VOPE)) {
-				free_v(b);
-				a->seq.v.v[i] = copy_v(c);
-				continue;
+			free(r);
+			iter_free(&it);
+			free_v(f);
+			free_v(l);
+			return (Ires) {FAIL, s};
+		}
+	}
+	iter_free(&it);
+	free_v(f);
+	free_v(l);
+	upd_prefix2(s, p, lst_of_vals(r, n));
+	return (Ires) {OK, s};
+}
+static Ires 
+op_filter(Env *e, Val *s, size_t p) {
+	/* rem: filter f (1, 2) keeps elements x where f (x,) is true */
+	Val *f, *l;
+	if (!set_prefix2_arg(e, s, p, &f, true, &l, true)) {
+		return (Ires) {FAIL, s};
+	}
+	Iter it;
+	if (!iter_check(l, __FUNCTION__) || !iter_init(&it, e, f, 1, __FUNCTION__)) {
+		free_v(f);
+		free_v(l);
+		return (Ires) {FAIL, s};
+	}
+	size_t n = len_v(l);
+	size_t k = 0;
+	Val **r = malloc(n * sizeof(Val*));
+	assert(n == 0 || r != NULL);
+	Val tmp;
+	for (size_t i=0; i<n; ++i) {
+		Val *x = iter_arg(e, l, i, &tmp);
+		Val *c = x == NULL ? NULL : iter_call(&it, e, &x);
+		if (c == NULL) {
+			free_v(x);
+			for (size_t j=0; j<k; ++j) {
+				free_v(r[j]);
 			}
+			free(r);
+			iter_free(&it);
+			free_v(f);
+			free_v(l);
+			return (Ires) {FAIL, s};
+		}
+		if (istrue_v(c)) {
+			r[k++] = x;
+		} else {
+			free_v(x);
 		}
+		free_v(c);
 	}
-	return (Ires) {OK, a};
+	iter_free(&it);
+	free_v(f);
+	free_v(l);
+	upd_prefix2(s, p, lst_of_vals(r, k));
+	return (Ires) {OK, s};
 }
+static bool nop_of(Val *a, nop *o);
 
 static Ires 
-reduce_seq(Env *e, Val *b) {
-	/* symbol application: consumes the seq, until 1 item left */
-	assert(b != NULL);
-	if (Dbg) { printf("#\t  %s entry: ", __FUNCTION__); printx_v(b,false,"#\t"); printf("\n"); }
-	Ires rc = (Ires) {NOP, b};
-	Val *c;
-	while (b->seq.v.n > 0) {
-		/* stop condition: seq reduced to single element */
-		if (b->seq.v.n == 1) {
-			/* reduction loop ends, return the reduced seq,
-			 * unless it's an operator of 0 arity,
-			 * then, fall through & execute it below */
-			/* (user functions all have one parameter) */
-			c = b->seq.v.v[0]; 
-			if (!(c->hdr.t == VOPE && c->symop.arity == 0)) {
-				rc.v = b;
-				return rc;
+op_fold(Env *e, Val *s, size_t p) {
+	/* rem: fold f 0 (1, 2) is f ((f (0, 1)), 2) */
+	Val *f, *acc, *l;
+	if (!set_prefix3_arg(e, s, p, &f, &acc, &l)) {
+		return (Ires) {FAIL, s};
+	}
+	Iter it;
+	if (!iter_check(l, __FUNCTION__) || !iter_init(&it, e, f, 2, __FUNCTION__)) {
+		free_v(f);
+		free_v(acc);
+		free_v(l);
+		return (Ires) {FAIL, s};
+	}
+	Val tmp;
+	size_t i = 0;
+	nop o;
+	if ((l->hdr.t == VARR || (l->hdr.t == VGEN && l->gen.v->f == NULL)) 
+			&& nop_of(f, &o) && (acc->hdr.t == VNAT || acc->hdr.t == VREA)) {
+		/* packed numbers or range, numeric operator: no seq per element, 
+		 * until a case left to the generic one (overflow, ...) */
+		for (size_t n=len_v(l); i<n; ++i) {
+			Val *b = elem_v(l, i, &tmp);
+			Val *c = stopped() ? NULL : num_fast(o, acc, b, kind_of(acc, b));
+			if (c == NULL) {
+				break;
 			}
+			free_v(acc);
+			acc = c;
 		}
-		int hiprio = minprio()+1;
-		size_t symat = 0;
-		bool symfound = false;
-		vtype symtype = 0;
-		/* apply symops from left to right (for same priority symbols) */
-		for (size_t i=0; i < b->seq.v.n; ++i) {
-			c = b->seq.v.v[i];
-			if (c->hdr.t == VFUN) {
-				if (FUNDEFPRIO < hiprio) {
-					hiprio = FUNDEFPRIO;
-					symat = i;
-					symfound = true;
-					symtype = VFUN;
-				}
-			} else if (c->hdr.t == VOPE) {
-				if (c->symop.prio < hiprio) {
-					hiprio = c->symop.prio;
-					symat = i;
-					symfound = true;
-					symtype = VOPE;
-				}
-			} 
-		}
-		if (!symfound) { 
-			printf("? %s: sequence without function ",__FUNCTION__);
-			print_v(b, true);
-			printf("\n");
-			return (Ires) {FAIL, b};
-		}
-		assert(symtype == VFUN || symtype == VOPE);
-		/* apply the symbol, returns the reduced seq */
-		if (symtype == VFUN) {
-			/* user defined function */
-			rc = apply_fun(e, b, symat);
-			assert(rc.code == OK || rc.code == FAIL);
-		} else if (symtype == VOPE) {
-			/* builtin operator */
-			rc = b->seq.v.v[symat]->symop.v(e, b, symat);
-		}
-		if (rc.code == FAIL || rc.code == BACK) {
-			return rc;
+	}
+	for (; i<len_v(l); ++i) {
+		Val *args[2] = {acc, iter_arg(e, l, i, &tmp)};
+		Val *c = args[1] == NULL ? NULL : iter_call(&it, e, args);
+		free_v(args[1]);
+		free_v(acc);
+		acc = c;
+		if (acc == NULL) {
+			iter_free(&it);
+			free_v(f);
+			free_v(l);
+			return (Ires) {FAIL, s};
 		}
-		/* rc.code set by the op_*() */
-		if (Dbg) { printf("#\t  %s reduced: ", __FUNCTION__); printx_v(b,false,""); printf("\n"); }
 	}
-	/* empty seq after reduction? */
-	printf("? %s: sequence unexpectedly empty\n",__FUNCTION__);
-	return (Ires) {FAIL, b};
+	iter_free(&it);
+	free_v(f);
+	free_v(l);
+	upd_prefix3(s, p, acc);
+	return (Ires) {OK, s};
 }
-static Ires 
-eval_loop(Env *e, Val *s) {
-	/* rem: loop execution */
-	if (Dbg) { printf("#\t  %s entry:\n", __FUNCTION__); }
-	Env *le = new_env(e);
-	if (le == NULL) {
-		printf("? %s: loop env creation failed\n",
-				__FUNCTION__);
-		return (Ires) {FAIL, s};
+
+/* --- worker pool, for pmap --- 
+ * a fixed set of threads, started on first use, runs queued tasks.
+ * The thread waiting for a batch runs queued tasks too, 
+ * so a pmap nested in a pmap'ed function cannot starve.
+ * Tasks only read the caller's env: it does not change while waiting.
+ */
+
+/* max workers, and their stack (the interpreter recurses a lot) */
+#define POOLMAX 64
+#define POOLSTACK (8 << 20)
+
+typedef struct {
+	pthread_mutex_t mx;
+	pthread_cond_t done;
+	size_t left;	/* tasks not finished */
+	/* of the context that runs the batch */
+	bool dbg;
+	bool jit;
+	bool opt;
+	FILE *out;
+	Limits *lim;
+} Batch;
+
+typedef struct {
+	void (*f)(void *arg);
+	void *arg;
+	Batch *b;
+} Task;
+
+typedef struct {
+	pthread_mutex_t mx;
+	pthread_cond_t more;
+	size_t nw;	/* workers started */
+	size_t n;	/* queued tasks, from head */
+	size_t head;
+	size_t cap;
+	Task *q;
+} Pool;
+
+static Pool Workers = {
+	.mx = PTHREAD_MUTEX_INITIALIZER, 
+	.more = PTHREAD_COND_INITIALIZER,
+};
+static pthread_once_t Workers_once = PTHREAD_ONCE_INIT;
+
+static bool
+pool_pop(Pool *a, Task *t) {
+	/* a locked */
+	if (a->n == 0) {
+		return false;
 	}
-	Val *v;
-	bool t;
-	while (!(le->state == STOP || le->state == RETURN)) {
-		for (size_t i=0; i<s->symf.body.n; ++i) {
-			v = copy_v(s->symf.body.v[i]);
-			t = transition(le, v);  /* consumes v */
-			if (!t) {
-				free_env(le, false);
-				return (Ires) {FAIL, s};
-			}
-			if (le->state == RETURN) {
-				break;
-			}
-			if (le->state == STOP) {
-				break;
-			}
+	*t = a->q[a->head];
+	a->head = (a->head + 1) % a->cap;
+	--(a->n);
+	return true;
+}
+static void
+task_run(Task *t) {
+	bool dbg = Dbg;
+	bool jit = Jit;
+	bool opt = Opt;
+	FILE *out = Outf;
+	Limits *lim = Lim;
+	Dbg = t->b->dbg;
+	Jit = t->b->jit;
+	Opt = t->b->opt;
+	Outf = t->b->out;
+	Lim = t->b->lim;
+	t->f(t->arg);
+	Dbg = dbg;
+	Jit = jit;
+	Opt = opt;
+	Outf = out;
+	Lim = lim;
+	pthread_mutex_lock(&t->b->mx);
+	if (--(t->b->left) == 0) {
+		pthread_cond_broadcast(&t->b->done);
+	}
+	pthread_mutex_unlock(&t->b->mx);
+}
+static void *
+pool_worker(void *arg) {
+	Pool *a = arg;
+	Task t;
+	while (1) {
+		pthread_mutex_lock(&a->mx);
+		while (!pool_pop(a, &t)) {
+			pthread_cond_wait(&a->more, &a->mx);
 		}
+		pthread_mutex_unlock(&a->mx);
+		task_run(&t);
 	}
-	if (Dbg) { printf("#\t  %s end:\n", __FUNCTION__); print_env(le, "#\t"); }
-	Symval *svit = lookup_id(le, ITNAME, false, NULL);
-	if (svit == NULL) {
-		printf("? %s: 'it from loop undefined\n",
-				__FUNCTION__);
-		free_env(le, false);
-		return (Ires) {FAIL, s};
+	return NULL;
+}
+static void
+pool_start() {
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t nw = ncpu > 1 ? ncpu - 1 : 0; /* caller is a worker too */
+	if (nw > POOLMAX) {
+		nw = POOLMAX;
+	}
+	pthread_attr_t at;
+	pthread_attr_init(&at);
+	pthread_attr_setstacksize(&at, POOLSTACK);
+	pthread_attr_setdetachstate(&at, PTHREAD_CREATE_DETACHED);
+	for (size_t i=0; i<nw; ++i) {
+		pthread_t th;
+		if (pthread_create(&th, &at, pool_worker, &Workers) != 0) {
+			break;
+		}
+		++(Workers.nw);
 	}
-	Ires rc = {OK, copy_v(svit->v)};
-	free_v(s);
-	/* update parent's symval with le's: */
-	for (int i = 0; i < le->n; ++i) {
-		if (le->s[i] == svit) {
-			free_symval(le->s[i]);
-			continue;
+	pthread_attr_destroy(&at);
+}
+static size_t
+pool_size() {
+	pthread_once(&Workers_once, pool_start);
+	return Workers.nw + 1;
+}
+static void
+pool_run(void (*f)(void *), void *args, size_t argsz, size_t n) {
+	/* f on each of the n args (an array of argsz bytes items), 
+	 * returns when all done */
+	Pool *a = &Workers;
+	Batch b;
+	pthread_mutex_init(&b.mx, NULL);
+	pthread_cond_init(&b.done, NULL);
+	b.left = n;
+	b.dbg = Dbg;
+	b.jit = Jit;
+	b.opt = Opt;
+	b.out = Outf;
+	b.lim = Lim;
+	pthread_mutex_lock(&a->mx);
+	if (a->n + n > a->cap) {
+		size_t cap = 2 * (a->n + n);
+		Task *q = malloc(cap * sizeof(*q));
+		assert(q != NULL);
+		for (size_t i=0; i<a->n; ++i) {
+			q[i] = a->q[(a->head + i) % a->cap];
 		}
-		if (!upded_sym(le->parent, le->s[i], false)) {
-			free_symval(le->s[i]);
+		free(a->q);
+		a->q = q;
+		a->cap = cap;
+		a->head = 0;
+	}
+	for (size_t i=0; i<n; ++i) {
+		Task *t = a->q + (a->head + a->n) % a->cap;
+		t->f = f;
+		t->arg = (char *)args + i*argsz;
+		t->b = &b;
+		++(a->n);
+	}
+	pthread_cond_broadcast(&a->more);
+	pthread_mutex_unlock(&a->mx);
+	/* help until the batch is done */
+	Task t;
+	while (1) {
+		pthread_mutex_lock(&a->mx);
+		bool got = pool_pop(a, &t);
+		pthread_mutex_unlock(&a->mx);
+		if (!got) {
+			break;
 		}
+		task_run(&t);
 	}
-	if (le->state == RETURN) {
-		rc.code = RET;
-	} 
-	if (le->state == STOP) {
-		rc.code = OK;
+	pthread_mutex_lock(&b.mx);
+	while (b.left > 0) {
+		pthread_cond_wait(&b.done, &b.mx);
 	}
-	free(le->s);
-	free(le);
-	return rc;
+	pthread_mutex_unlock(&b.mx);
+	pthread_cond_destroy(&b.done);
+	pthread_mutex_destroy(&b.mx);
 }
-static Ires 
-solve_seq(Env *e, Val *a, bool lookall, bool lookit) {
-	if (a->seq.v.n == 0) {
-		Val *b = malloc(sizeof(*b));
-		b->hdr.t = VNIL;
-		free_v(a);
-		return (Ires) {OK, b};
+
+/* pmap on smaller lists runs as map */
+#define PMAPMIN 64
+
+typedef struct {
+	Env *e;
+	Val *f;
+	Val *l;
+	size_t from, to;
+	Val **r;
+	bool ok;
+} Chunk;
+
+static void
+pmap_chunk(void *arg) {
+	/* map over l[from, to), with its own local env */
+	Chunk *c = arg;
+	Iter it;
+	c->ok = false;
+	if (!iter_init(&it, c->e, c->f, 1, "op_pmap")) {
+		return;
 	}
-	Ires rc;
-	/* resolve all syms to functions to prepare for reduction: */
-	for (size_t i=0; i < a->seq.v.n; ++i) {
-		rc = eval_run(e, a->seq.v.v[i], lookall, lookit);
-		if (!(rc.code == OK || rc.code == NOP)) {
-			return rc;
+	Val tmp;
+	for (size_t i=c->from; i<c->to; ++i) {
+		Val *x = iter_arg(c->e, c->l, i, &tmp);
+		c->r[i] = x == NULL ? NULL : iter_call(&it, c->e, &x);
+		free_v(x);
+		if (c->r[i] == NULL) {
+			for (size_t j=c->from; j<i; ++j) {
+				free_v(c->r[j]);
+			}
+			iter_free(&it);
+			return;
 		}
-		a->seq.v.v[i] = rc.v;
 	}
-	rc = reduce_seq(e, a);
-	if (rc.code == FAIL || rc.code == BACK) {
-		return rc;
-	} 
-	rc.v = a->seq.v.v[0]; /* steal single seq item left */
-	a->seq.v.n = 0;
-	free_v(a);
-	return rc;
-}
-static Ires
-copy_solve(Env *e, Val *a, bool lookall, bool lookit) {
-	if (a->hdr.t == VSYM) {
-		return solve_sym(e, a, lookall, lookit);
-	} 
-	return (Ires) {NOP, copy_v(a)};
+	iter_free(&it);
+	c->ok = true;
 }
 static Ires 
-solve_sym(Env *e, Val *a, bool lookall, bool lookit) {
-	assert(a->hdr.t == VSYM);
-	/* resolve operators */
-	Symop *so = lookup_op(a->sym.v);
-	if (so != NULL) {
-		Val *b = malloc(sizeof(*b));
-		b->hdr.t = VOPE;
-		b->symop.prio = so->prio;
-		b->symop.v = so->f;
-		b->symop.arity = so->arity;
-		strncpy(b->symop.name, so->name, 1+strlen(so->name));
-		return (Ires) {OK, b};
+op_pmap(Env *e, Val *s, size_t p) {
+	/* rem: pmap f l, as map f l on all cores, for pure functions */
+	Val *f, *l;
+	if (!set_prefix2_arg(e, s, p, &f, true, &l, true)) {
+		return (Ires) {FAIL, s};
 	}
-	bool isit = strncmp(a->sym.v, IT, sizeof(a->sym.v)) == 0;
-	/* resolve 'it */
-	if (isit && lookit) {
-		Val *b = lookup(e, ITNAME, false, false);
-		if (b == NULL) {
-			printf("? %s: 'it undefined\n",
-				__FUNCTION__);
-			return (Ires) {FAIL, a};
-		} 
-		return (Ires) {OK, copy_v(b)};
+	Iter it;
+	if (!iter_check(l, __FUNCTION__) || !iter_init(&it, e, f, 1, __FUNCTION__)) {
+		free_v(f);
+		free_v(l);
+		return (Ires) {FAIL, s};
 	}
-	/* resolve all symbols (except 'it), if requested */
-	if ((!isit) && lookall) {
-		Val *b = lookup(e, a->sym.v, true, true);
-		if (b == NULL) {
-			printf("? %s: unknown symbol '%s\n",
-				__FUNCTION__, a->sym.v);
-			return (Ires) {FAIL, a};
-		} 
-		return (Ires) {OK, copy_v(b)};
+	iter_free(&it);
+	if (f->hdr.t == VFUN && f->symf.code == NULL) {
+		/* before the workers share f */
+		f->symf.code = code_of(f->symf.body);
 	}
-	/* resolve symbol if it points to function: */
-	Val *b = lookup(e, a->sym.v, true, true);
-	if (b != NULL && (b->hdr.t == VFUN
-			|| b->hdr.t == VOPE)) {
-		return (Ires) {OK, copy_v(b)};
+	size_t n = len_v(l);
+	size_t nc = n < PMAPMIN ? 1 : 4 * pool_size();
+	if (nc > n) {
+		nc = n > 0 ? n : 1;
 	}
-	return (Ires) {NOP, copy_v(a)};
-}
-static Ires 
-solve_lst(Env *e, Val *a, bool lookall, bool lookit) {
-	if (Dbg) { 
-		printf("#\t  %s entry: (all=%d, it=%d) ", __FUNCTION__, lookall, lookit); 
-		printx_v(a, false,"#\t"); printf("\n"); 
+	Val **r = malloc(n * sizeof(Val*));
+	Chunk *c = malloc(nc * sizeof(*c));
+	assert((n == 0 || r != NULL) && c != NULL);
+	for (size_t i=0; i<nc; ++i) {
+		c[i] = (Chunk) {e, f, l, i*n/nc, (i+1)*n/nc, r, false};
 	}
-	Ires rc;
-	for (size_t i=0; i < a->lst.v.n; ++i) {
-		rc = eval_run(e, a->seq.v.v[i], lookall, lookit);
-		if (!(rc.code == OK || rc.code == NOP)) {
-			return (Ires) {FAIL, a};
+	if (nc == 1) {
+		pmap_chunk(c);
+	} else {
+		pool_run(pmap_chunk, c, sizeof(*c), nc);
+	}
+	bool ok = true;
+	for (size_t i=0; i<nc; ++i) {
+		ok = ok && c[i].ok;
+	}
+	if (!ok) {
+		for (size_t i=0; i<nc; ++i) {
+			for (size_t j=c[i].from; c[i].ok && j<c[i].to; ++j) {
+				free_v(r[j]);
+			}
 		}
-		a->seq.v.v[i] = rc.v;
+		free(r);
+		free(c);
+		free_v(f);
+		free_v(l);
+		return (Ires) {FAIL, s};
 	}
-	if (Dbg) { printf("#\t  %s exit: ", __FUNCTION__); printx_v(a, false,"#\t"); printf("\n"); }
-	return (Ires) {OK, a};
+	free(c);
+	free_v(f);
+	free_v(l);
+	upd_prefix2(s, p, lst_of_vals(r, n));
+	return (Ires) {OK, s};
 }
 
-static Ires 
-eval_run(Env *e, Val *a, bool lookall, bool lookit) {
-	/* returns a val, if successful: it's new and freed 'a */
-	Ires r = {NOP, a};
-	if (a->hdr.t == VSYM) {
-		r = solve_sym(e, a, lookall, lookit);
-		if (r.code == OK || r.code == NOP) {
-			free_v(a);
-			r.code = OK;
-		} 
-		return r;
-	}
-	if (a->hdr.t == VSEQ) {
-		return solve_seq(e, a, lookall, lookit);
+/* --- lazy sequences: long ranges, generate --- 
+ * elements are made when taken: map, filter, fold, pmap, at and print 
+ * go through them one by one, other operators get them materialized.
+ */
+
+static Val *
+gen_at(Env *e, Val *a, size_t i) {
+	/* i-th element of lazy a, fresh, NULL if its function failed */
+	Gen *g = a->gen.v;
+	Val x;
+	x.hdr.t = VNAT;
+	x.nat.v = g->from + (long long)i;
+	if (g->f == NULL) {
+		return copy_v(&x);
+	}
+	Iter it;
+	if (!iter_init(&it, e, g->f, 1, __FUNCTION__)) {
+		return NULL;
 	}
+	Val *px = &x;
+	Val *r = iter_call(&it, e, &px);
+	iter_free(&it);
 	return r;
 }
-
-static void 
-update_freesym(Env *e, Val *fun, Val *s) {
-	Val *c, *fv = NULL;
-	for (size_t i=0; i<s->seq.v.n; ++i) {
-		c = s->seq.v.v[i];
-		if (c->hdr.t == VSYM) {
-			/* 'it resolved later, at fun execution */
-			if (strncmp(c->sym.v, IT, sizeof(c->sym.v)) == 0) {
-				continue;
-			}
-			/* skip recursive call */
-			if (strncmp(c->sym.v, fun->symf.name, sizeof(c->sym.v)) == 0) {
-				continue;
-			}
-			/* ignore function parameters */
-			int id = position(c, fun->symf.param);
-			if (id != -1) {
-				continue;
+static Val *
+force_v(Env *e, Val *a) {
+	/* lazy a (consumed) materialized: a range as an array, 
+	 * a generator as the list of its elements, NULL if one failed */
+	Gen *g = a->gen.v;
+	size_t n = g->n;
+	if (Trace & EVFORCE) { trace_ev(EVFORCE, g->f != NULL, 0, n, NULL); }
+	if (g->f == NULL) {
+		Val *b = arr_v(VNAT, n);
+		for (size_t i=0; i<n; ++i) {
+			b->arr.v->v.nat[i] = g->from + (long long)i;
+		}
+		free_v(a);
+		return b;
+	}
+	Iter it;
+	if (!iter_init(&it, e, g->f, 1, __FUNCTION__)) {
+		free_v(a);
+		return NULL;
+	}
+	Val **r = malloc(n * sizeof(Val*));
+	assert(n == 0 || r != NULL);
+	for (size_t i=0; i<n; ++i) {
+		Val x;
+		x.hdr.t = VNAT;
+		x.nat.v = g->from + (long long)i;
+		Val *px = &x;
+		r[i] = iter_call(&it, e, &px);
+		if (r[i] == NULL) {
+			for (size_t j=0; j<i; ++j) {
+				free_v(r[j]);
 			}
-			Val *l = lookup(e, c->sym.v, true, false);
-			/* unknown sym, can be normal, determined in function or operator */
-			if (l == NULL) {
-				continue;
+			free(r);
+			iter_free(&it);
+			free_v(a);
+			return NULL;
+		}
+	}
+	iter_free(&it);
+	free_v(a);
+	return lst_of_vals(r, n);
+}
+static bool
+print_gen(Env *e, Val *a) {
+	/* lazy a as lists print, up to LAZYPRINT elements made */
+	Gen *g = a->gen.v;
+	size_t n = g->n < LAZYPRINT ? g->n : LAZYPRINT;
+	Val *x[LAZYPRINT];
+	for (size_t i=0; i<n; ++i) {
+		x[i] = gen_at(e, a, i);
+		if (x[i] == NULL) {
+			for (size_t j=0; j<i; ++j) {
+				free_v(x[j]);
 			}
-			/* closure: replace sym with value from env */
-			fv = copy_v(l);
-		} else if (c->hdr.t == VSEQ || c->hdr.t == VLST) {
-			update_freesym(e, fun, c);
-			fv = copy_v(c);
-		} else {
-			continue;
+			return false;
 		}
-		free_v(c);
-		s->seq.v.v[i] = fv;
 	}
+	outf("{ ");
+	for (size_t i=0; i<n; ++i) {
+		print_v(x[i], false);
+		free_v(x[i]);
+	}
+	if (g->n > LAZYPRINT) {
+		outf(".. x%lu ", g->n);
+	}
+	outf("} ");
+	return true;
 }
-
-static Ires
-eval_fun_body(Env *e, Val *s, size_t p) {
-	if (Dbg) { printf("#\t  %s entry: ", __FUNCTION__); printx_v(s, false,"#\t"); printf("\n"); }
-	Val *fun = lookup(e, ITNAME, false, false);
-	if (fun == NULL) {
-		printf("? %s: 'it undefined\n", __FUNCTION__);
+static Ires 
+op_generate(Env *e, Val *s, size_t p) {
+	/* rem: generate f 3 is f (0,), f (1,), f (2,), made when taken */
+	Val *f, *n;
+	if (!set_prefix2_arg(e, s, p, &f, true, &n, true)) {
 		return (Ires) {FAIL, s};
 	}
-	if (fun->hdr.t != VFUN) {
-		printf("? %s: no function under definition\n", __FUNCTION__);
+	if (n->hdr.t != VNAT || n->nat.v < 0) {
+		outf("? %s: second argument not a natural number\n", 
+				__FUNCTION__);
+		free_v(f);
+		free_v(n);
 		return (Ires) {FAIL, s};
 	}
-	Val *fret = copy_v(fun);
-	/* replace free symbols with env value: */
-	update_freesym(e, fret, s);
-	fret->symf.body = push_l(fret->symf.body, s);
-	if (Dbg) { printf("#\t  %s exit: ", __FUNCTION__); printx_v(s,false,"#\t"); printf("\n"); }
-	return (Ires) {OK, fret};
-}
-
-static Ires
-eval_loop_body(Env *e, Val *s, size_t p) {
-	Val *loop = lookup(e, ITNAME, false, false);
-	if (loop == NULL) {
-		printf("? %s: 'it required, yet undefined\n", __FUNCTION__);
+	Iter it;
+	if (!iter_init(&it, e, f, 1, __FUNCTION__)) {
+		free_v(f);
+		free_v(n);
 		return (Ires) {FAIL, s};
 	}
-	if (loop->hdr.t != VFUN) {
-		printf("? %s: 'it is not a `loop function\n", __FUNCTION__);
-		return (Ires) {FAIL, s};
+	iter_free(&it);
+	if (f->hdr.t == VFUN && f->symf.code == NULL) {
+		/* before pmap workers share f */
+		f->symf.code = code_of(f->symf.body);
 	}
-	Val *lret = copy_v(loop);
-	lret->symf.body = push_l(lret->symf.body, s);
-	return (Ires) {OK, lret};
+	Val *g = gen_v(0, n->nat.v, f);
+	free_v(n);
+	upd_prefix2(s, p, g);
+	return (Ires) {OK, s};
 }
-static Ires
-eval_maybe_def(Env *e, Val *a) {
-	/* returns a val, if new, freed 'a */
-	if (Dbg) { printf("#\t  %s entry: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	/* resolve symbols (not 'it) to operators and functions */
-	Ires rc = solve_lst(e, a, false, false);
-	if (rc.code != OK) {
-		rc.code = FAIL;
-		return rc;
+static bool
+lazy_op(Val *a) {
+	/* operators taking lazy sequences as they are */
+	if (a->hdr.t != VOPE) {
+		return false;
 	}
-	if (Dbg) { printf("#\t  %s resolved: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	/* rem: expecting end 'foo */
-	if (a->seq.v.v[0]->hdr.t == VOPE 
-			&& a->seq.v.v[0]->symop.v == op_end
-			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
-			&& a->seq.v.v[1]->hdr.t == VSYM) {
-		Ires rc = eval_run(e, a, false, false);
-		/* if an end 'fun: */
-		if (rc.code != BACK) {
-			// OK, FAIL
-			return rc;
+	Ires (*f)(Env *e, Val *s, size_t p) = a->symop.v;
+	return f == op_map || f == op_filter || f == op_fold || f == op_pmap 
+		|| f == op_at || f == op_print || f == op_call || f == op_solve;
+}
+static Val *
+strict_arg(Env *e, Val *s, size_t p, Val *a) {
+	/* argument a (consumed) of the operator at p, 
+	 * materialized if lazy and not taken as is, NULL if that failed */
+	if (a->hdr.t != VGEN || lazy_op(s->seq.v.v[p])) {
+		return a;
+	}
+	return force_v(e, a);
+}
+
+/* --------------- builtin or base function symbols -------------------- */
+
+/* user defined fun priority */
+#define FUNDEFPRIO 0
+
+typedef struct Symop_ {
+	char name[WSZ];
+	int prio;
+	Ires (*f)(Env *e, Val *s, size_t p);
+	int arity;
+} Symop;
+
+static const Symop Syms[] = {
+	(Symop) {"call",   -20, op_call,   2},
+	(Symop) {"define", -20, op_def,    2},
+	(Symop) {"def",    -20, op_def,    2},
+	(Symop) {"do",     -20, op_do,     1},
+	(Symop) {"else",   -20, op_else,   0},
+	(Symop) {"end",    -20, op_end,    1}, /* needs to be prior to loop, if, ufun */
+	(Symop) {"env",    -20, op_env,    0},
+	(Symop) {"save-image", -20, op_save_image, 1},
+	(Symop) {"load-array", -20, op_load_array, 2},
+	(Symop) {"save-array", -20, op_save_array, 2},
+	(Symop) {"list",   -20, op_list,  -1},
+	(Symop) {"loop",   -20, op_loop,   0},
+	(Symop) {"print",  -20, op_print,  1}, 
+	(Symop) {"range",  -20, op_range,  2},
+	(Symop) {"generate", -20, op_generate, 2},
+	(Symop) {"array",  -20, op_array,  1},
+	(Symop) {"vector", -20, op_vector, 1},
+	(Symop) {"append", -20, op_append, 2},
+	(Symop) {"prepend",-20, op_prepend,2},
+	(Symop) {"concat", -20, op_concat, 2},
+	(Symop) {"at",     -20, op_at,     2},
+	(Symop) {"set",    -20, op_set,    3},
+	(Symop) {"map",    -20, op_map,    2},
+	(Symop) {"pmap",   -20, op_pmap,   2},
+	(Symop) {"filter", -20, op_filter, 2},
+	(Symop) {"fold",   -20, op_fold,   3},
+	(Symop) {"rem:",   -20, op_rem,   -1}, /* -1 arity: remainder of seq val */
+	(Symop) {"return", -20, op_return, 0},
+	(Symop) {"stop",   -20, op_stop,   0},
+	(Symop) {"solve",  -20, op_solve,  1},
+	(Symop) {"true?",  -20, op_true,   0},
+	(Symop) {"false?", -20, op_false,  0},
+	(Symop) {"=",      -10, op_eq,  2},
+	(Symop) {"/=",     -10, op_neq, 2},
+	(Symop) {"<",    40, op_les, 2},
+	(Symop) {"<=",   40, op_leq, 2},
+	(Symop) {">",    40, op_gre, 2},
+	(Symop) {">=",   40, op_geq, 2},
+	(Symop) {"~=",   40, op_eqv, 2},
+	/* priority FUNDEFPRIO (0) is for function (user defined) */
+	(Symop) {"*",    20, op_mul, 2},
+	(Symop) {"/",    20, op_div, 2},
+	(Symop) {"+",    30, op_plu, 2},
+	(Symop) {"-",    30, op_min, 2},
+	/* (Symop) {"=",    40, op_eq,  2}, */
+	(Symop) {"not",  50, op_not, 1},
+	(Symop) {"and",  60, op_and, 2},
+	(Symop) {"or",   70, op_or,  2},
+	(Symop) {"if",   80, op_if,  1},
+	(Symop) {"",      0, op_false, -1},
+};
+static int
+minprio() {
+	int m = 0;
+	for (int i=0; Syms[i].name[0] != '\0'; ++i) {
+		if (Syms[i].prio > m) {
+			m = Syms[i].prio;
+		}
+	}
+	return m;
+}
+static const Symop *
+lookup_op(char *a) {
+	for (size_t i=0; Syms[i].name[0] != '\0'; ++i) {
+		const Symop *b = Syms+i;
+		if (strncmp(b->name, a, sizeof(b->name)) == 0) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+/* per thread cache entries of the sites, see Symgen */
+static size_t Sites;
+typedef struct {
+	size_t site;	/* 0: unused */
+	const Symop *op;	/* the operator named, NULL if none */
+	size_t g;	/* name's slot in Symgen */
+	uint64_t env;	/* id of the env sv was found from, 0 if none */
+	uint64_t gen;
+	Symval *sv;	/* NULL: unbound */
+} Ic;
+static __thread Ic Ics[ICSZ];
+
+static Ic *
+ic_of(Val *a) {
+	/* a's cache entry, NULL if a is not a site */
+	if (a->sym.site == 0) {
+		return NULL;
+	}
+	Ic *c = Ics + a->sym.site % ICSZ;
+	if (c->site != a->sym.site) {
+		*c = (Ic) {a->sym.site, lookup_op(a->sym.v), 
+			hash_str(a->sym.v) % SGSZ, 0, 0, NULL};
+	}
+	return c;
+}
+static Val *
+lookup_ic(Env *e, Val *a) {
+	/* as lookup(e, a's name, true, true), through a's cache */
+	Ic *c = ic_of(a);
+	if (c == NULL) {
+		return lookup(e, a->sym.v, true, true);
+	}
+	uint64_t gen = __atomic_load_n(&Symgen[c->g], __ATOMIC_RELAXED);
+	Symval *sv;
+	if (c->env == e->id && c->gen == gen) {
+		sv = c->sv;
+	} else if (e->parent != NULL && c->env == e->parent->id && c->gen == gen) {
+		/* found from the caller: unless bound here */
+		sv = lookup_id(e, a->sym.v, false, NULL);
+		if (sv == NULL) {
+			sv = c->sv;
+		}
+	} else {
+		sv = lookup_id(e, a->sym.v, true, NULL);
+	}
+	if (sv != NULL && sv->v->hdr.t == VSYM) {
+		/* names of names: not cached */
+		c->env = 0;
+		return lookup(e, a->sym.v, true, true);
+	}
+	c->env = e->id;
+	c->gen = gen;
+	c->sv = sv;
+	return sv != NULL ? sv->v : NULL;
+}
+static bool
+isop_sym(Val *a) {
+	Ic *c = ic_of(a);
+	return (c != NULL ? c->op : lookup_op(a->sym.v)) != NULL;
+}
+static void
+site_v(Val *a) {
+	/* give the symbols of a, part of a stored body, their cache entry */
+	if (a->hdr.t == VSYM && a->sym.site == 0) {
+		a->sym.site = __atomic_add_fetch(&Sites, 1, __ATOMIC_RELAXED);
+	} else if (a->hdr.t == VOPE && a->symop.site == 0) {
+		a->symop.site = __atomic_add_fetch(&Sites, 1, __ATOMIC_RELAXED);
+	} else if (a->hdr.t == VSEQ || a->hdr.t == VLST) {
+		for (size_t i=0; i<a->seq.v.n; ++i) {
+			site_v(a->seq.v.v[i]);
+		}
+	}
+}
+
+/* --------------- user defined value symbols -------------------- */
+
+
+static bool
+isatom_v(Val *a) {
+	assert(a != NULL);
+	return (a->hdr.t == VNIL 
+			|| a->hdr.t == VNAT 
+			|| a->hdr.t == VREA
+			|| a->hdr.t == VSYM
+			|| a->hdr.t == VFUN
+			|| a->hdr.t == VOPE);
+}
+
+static Val *
+val_of_seme(Env *e, Sem *s) {
+	/* returns fresh value, 's untouched */
+	assert(s != NULL && "seme null");
+	Val *a = NULL;
+	if (s->hdr.t == SNIL ) {
+		a = malloc(sizeof(*a));
+		a->hdr.t = VNIL;
+		a->hdr.lent = false;
+		return a;
+	}
+	if (s->hdr.t == SNAT) {
+		a = malloc(sizeof(*a));
+		a->hdr.t = VNAT;
+		a->hdr.lent = false;
+		a->nat.v = s->nat.v;
+		return a;
+	}
+	if (s->hdr.t == SREA) {
+		a = malloc(sizeof(*a));
+		a->hdr.t = VREA;
+		a->hdr.lent = false;
+		a->rea.v = s->rea.v;
+		return a;
+	}
+	if (s->hdr.t == SBIG) {
+		return big_of_str(s->big.v);
+	}
+	if (s->hdr.t == SSYM) {
+		a = malloc(sizeof(*a));
+		assert(a != NULL);
+		a->hdr.t = VSYM;
+		a->hdr.lent = false;
+		strncpy(a->sym.v, s->sym.v, 1+strlen(s->sym.v));
+		a->sym.site = 0;
+		return a;
+	}
+	if (s->hdr.t == SLST) {
+		size_t n = s->lst.v.n;
+		Sem *l = s->lst.v.s;
+		Val *d;
+		/* numbers all of one type: packed */
+		size_t k = 0;
+		while (k < n && (l[k].hdr.t == SNAT || l[k].hdr.t == SREA)
+				&& l[k].hdr.t == l[0].hdr.t) {
+			++k;
+		}
+		if (n >= PACKMIN && k == n) {
+			a = arr_v(l[0].hdr.t == SNAT ? VNAT : VREA, n);
+			for (size_t i=0; i<n; ++i) {
+				if (l[i].hdr.t == SNAT) {
+					a->arr.v->v.nat[i] = l[i].nat.v;
+				} else {
+					a->arr.v->v.rea[i] = l[i].rea.v;
+				}
+			}
+			return a;
+		}
+		for (size_t i=0; i<n; ++i) {
+			d = val_of_seme(e, l+i);
+			if (d == NULL) {
+				free_v(a);
+				return NULL;
+			}
+			a = push_v(VLST, a, d);
+		}
+		return a;
+	}
+	if (s->hdr.t == SSEQ) {
+		size_t n = s->seq.v.n;
+		Sem *l = s->seq.v.s;
+		Val *d;
+		for (size_t i=0; i<n; ++i) {
+			d = val_of_seme(e, l+i);
+			if (d == NULL) {
+				free_v(a);
+				return NULL;
+			}
+			a = push_v(VSEQ, a, d);
+		}
+		return a;
+	}
+	outf("? %s: unknown seme\n",
+			__FUNCTION__);
+	return NULL;
+}
+
+/* ----- evaluation, pass 2, symbolic computation ----- */
+
+static Ires 
+solve_fun(Env *e, Val *a, List_v param) {
+	/* works on SEQ and LST, leaves the names of param alone */
+	assert(a->hdr.t == VSEQ || a->hdr.t == VLST);
+	Val *b = NULL;
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		b = a->seq.v.v[i];
+		if (b->hdr.t == VSYM && position(b, param) == -1) {
+			Val *c = NULL;
+			const Symop *so = lookup_op(b->sym.v);
+			if (so != NULL) {
+				c = malloc(sizeof(*c));
+				c->hdr.t = VOPE;
+				c->hdr.lent = false;
+				c->symop.prio = so->prio;
+				c->symop.v = so->f;
+				c->symop.arity = so->arity;
+				c->symop.site = b->sym.site;
+				strncpy(c->symop.name, so->name, 1+strlen(so->name));
+				free_v(b);
+				a->seq.v.v[i] = c;
+				continue;
+			}
+			if (strncmp(b->sym.v, IT, sizeof(b->sym.v)) == 0) {
+				/* 'it is resolved at exec */
+				continue;
+			}
+			c = lookup(e, b->sym.v, true, true);
+			if (c != NULL && (c->hdr.t == VFUN
+					|| c->hdr.t == VOPE)) {
+				free_v(b);
+				a->seq.v.v[i] = copy_v(c);
+				continue;
+			}
+		}
+	}
+	touch_v(a);
+	return (Ires) {OK, a};
+}
+
+static Ires 
+reduce_seq(Env *e, Val *b) {
+	/* symbol application: consumes the seq, until 1 item left */
+	assert(b != NULL);
+	Ires rc = (Ires) {NOP, b};
+	Val *c;
+	while (b->seq.v.n > 0) {
+		if (stopped()) {
+			return (Ires) {FAIL, b};
+		}
+		/* stop condition: seq reduced to single element */
+		if (b->seq.v.n == 1) {
+			/* reduction loop ends, return the reduced seq,
+			 * unless it's an operator of 0 arity,
+			 * then, fall through & execute it below */
+			/* (user functions all have one parameter) */
+			c = b->seq.v.v[0]; 
+			if (!(c->hdr.t == VOPE && c->symop.arity == 0)) {
+				rc.v = b;
+				return rc;
+			}
+		}
+		int hiprio = minprio()+1;
+		size_t symat = 0;
+		bool symfound = false;
+		vtype symtype = 0;
+		/* apply symops from left to right (for same priority symbols) */
+		for (size_t i=0; i < b->seq.v.n; ++i) {
+			c = b->seq.v.v[i];
+			if (c->hdr.t == VFUN) {
+				if (FUNDEFPRIO < hiprio) {
+					hiprio = FUNDEFPRIO;
+					symat = i;
+					symfound = true;
+					symtype = VFUN;
+				}
+			} else if (c->hdr.t == VOPE) {
+				if (c->symop.prio < hiprio) {
+					hiprio = c->symop.prio;
+					symat = i;
+					symfound = true;
+					symtype = VOPE;
+				}
+			} 
+		}
+		if (!symfound) { 
+			outf("? %s: sequence without function ",__FUNCTION__);
+			print_v(b, true);
+			outf("\n");
+			return (Ires) {FAIL, b};
+		}
+		assert(symtype == VFUN || symtype == VOPE);
+		if (Trace & EVREDUCE) { 
+			c = b->seq.v.v[symat];
+			trace_ev(EVREDUCE, 0, symat, b->seq.v.n, 
+					symtype == VFUN ? c->symf.name : c->symop.name); 
+		}
+		/* apply the symbol, returns the reduced seq */
+		if (symtype == VFUN) {
+			/* user defined function */
+			rc = apply_fun(e, b, symat);
+			assert(rc.code == OK || rc.code == FAIL);
+		} else if (symtype == VOPE) {
+			/* builtin operator */
+			rc = b->seq.v.v[symat]->symop.v(e, b, symat);
+		}
+		if (rc.code == FAIL || rc.code == BACK) {
+			return rc;
+		}
+		/* rc.code set by the op_*() */
+	}
+	/* empty seq after reduction? */
+	outf("? %s: sequence unexpectedly empty\n",__FUNCTION__);
+	return (Ires) {FAIL, b};
+}
+static Ires 
+eval_loop(Env *e, Val *s) {
+	/* rem: loop execution, in place in e, of loop s (kept).
+	 * The loop starts with 'it Nil, symbols it creates are dropped 
+	 * at the end, those of e it changes keep their last value. */
+	size_t n0 = e->n;
+	istate st = e->state;
+	Val *v = malloc(sizeof(*v));
+	v->hdr.t = VNIL;
+	v->hdr.lent = false;
+	set_symval(e, ITNAME, v);
+	e->state = RUN;
+	++(e->loops);
+	bool t = true;
+	uint64_t pass = 0;
+	while (t && !(e->state == STOP || e->state == RETURN)) {
+		if (Trace & EVLOOP) { trace_ev(EVLOOP, e->loops, 0, pass++, NULL); }
+		t = run_body(e, s, true);
+	}
+	--(e->loops);
+	/* drop the loop's own symbols */
+	for (size_t i=n0; i<e->n; ++i) {
+		bump_sym(e->s[i]->name);
+		free_symval(e->s[i]);
+	}
+	e->n = n0;
+	if (!t) {
+		return (Ires) {FAIL, NULL};
+	}
+	Val *it = lookup(e, ITNAME, false, false);
+	Ires rc = {OK, copy_v(it)};
+	if (e->state == RETURN) {
+		rc.code = RET;
+	} 
+	e->state = st;
+	return rc;
+}
+static Ires 
+solve_seq(Env *e, Val *a, bool lookall, bool lookit) {
+	if (a->seq.v.n == 0) {
+		Val *b = malloc(sizeof(*b));
+		b->hdr.t = VNIL;
+		b->hdr.lent = false;
+		free_v(a);
+		return (Ires) {OK, b};
+	}
+	Ires rc;
+	/* resolve all syms to functions to prepare for reduction: */
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		rc = eval_run(e, a->seq.v.v[i], lookall, lookit);
+		if (!(rc.code == OK || rc.code == NOP)) {
+			return rc;
+		}
+		a->seq.v.v[i] = rc.v;
+	}
+	rc = reduce_seq(e, a);
+	if (rc.code == FAIL || rc.code == BACK) {
+		return rc;
+	} 
+	rc.v = a->seq.v.v[0]; /* steal single seq item left */
+	if (islent_v(rc.v)) {
+		rc.v = copy_v(rc.v);
+	}
+	a->seq.v.n = 0;
+	free_v(a);
+	return rc;
+}
+static Ires
+copy_solve(Env *e, Val *a, bool lookall, bool lookit) {
+	if (a->hdr.t == VSYM) {
+		return solve_sym(e, a, lookall, lookit);
+	} 
+	return (Ires) {NOP, copy_v(a)};
+}
+static Ires 
+solve_sym(Env *e, Val *a, bool lookall, bool lookit) {
+	assert(a->hdr.t == VSYM);
+	/* resolve operators */
+	Ic *ic = ic_of(a);
+	const Symop *so = ic != NULL ? ic->op : lookup_op(a->sym.v);
+	if (so != NULL) {
+		Val *b = malloc(sizeof(*b));
+		b->hdr.t = VOPE;
+		b->hdr.lent = false;
+		b->symop.prio = so->prio;
+		b->symop.v = so->f;
+		b->symop.arity = so->arity;
+		b->symop.site = a->sym.site;
+		strncpy(b->symop.name, so->name, 1+strlen(so->name));
+		return (Ires) {OK, b};
+	}
+	bool isit = strncmp(a->sym.v, IT, sizeof(a->sym.v)) == 0;
+	/* resolve 'it */
+	if (isit && lookit) {
+		Val *b = lookup(e, ITNAME, false, false);
+		if (b == NULL) {
+			outf("? %s: 'it undefined\n",
+				__FUNCTION__);
+			return (Ires) {FAIL, a};
+		} 
+		return (Ires) {OK, copy_v(b)};
+	}
+	/* resolve all symbols (except 'it), if requested */
+	if ((!isit) && lookall) {
+		Val *b = lookup_ic(e, a);
+		if (b == NULL) {
+			outf("? %s: unknown symbol '%s\n",
+				__FUNCTION__, a->sym.v);
+			return (Ires) {FAIL, a};
+		} 
+		return (Ires) {OK, copy_v(b)};
+	}
+	/* resolve symbol if it points to function: */
+	Val *b = lookup_ic(e, a);
+	if (b != NULL && (b->hdr.t == VFUN
+			|| b->hdr.t == VOPE)) {
+		return (Ires) {OK, copy_v(b)};
+	}
+	return (Ires) {NOP, copy_v(a)};
+}
+static Ires 
+solve_lst(Env *e, Val *a, bool lookall, bool lookit) {
+	Ires rc;
+	for (size_t i=0; i < a->lst.v.n; ++i) {
+		rc = eval_run(e, a->seq.v.v[i], lookall, lookit);
+		if (!(rc.code == OK || rc.code == NOP)) {
+			return (Ires) {FAIL, a};
+		}
+		a->seq.v.v[i] = rc.v;
+	}
+	touch_v(a);
+	return (Ires) {OK, a};
+}
+
+static Ires 
+solve_top(Env *e, Val *a, bool lookit) {
+	/* as solve_lst, for lines kept for later (function and loop bodies, 
+	 * skipped lines): only a's own symbols, sub-sequences are left 
+	 * to be solved when run */
+	Ires rc;
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		if (a->seq.v.v[i]->hdr.t != VSYM) {
+			continue;
+		}
+		rc = eval_run(e, a->seq.v.v[i], false, lookit);
+		if (!(rc.code == OK || rc.code == NOP)) {
+			return (Ires) {FAIL, a};
+		}
+		a->seq.v.v[i] = rc.v;
+	}
+	return (Ires) {OK, a};
+}
+
+static Ires 
+eval_run(Env *e, Val *a, bool lookall, bool lookit) {
+	/* returns a val, if successful: it's new and freed 'a */
+	Ires r = {NOP, a};
+	if (a->hdr.t == VSYM) {
+		r = solve_sym(e, a, lookall, lookit);
+		if (r.code == OK || r.code == NOP) {
+			drop_v(a);
+			r.code = OK;
+		} 
+		return r;
+	}
+	if (a->hdr.t == VSEQ) {
+		return solve_seq(e, a, lookall, lookit);
+	}
+	return r;
+}
+
+static bool
+known_sym(Symval **s, size_t n, const char *name) {
+	for (size_t i=0; i<n; ++i) {
+		if (strncmp(s[i]->name, name, WSZ) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+static void 
+free_syms(Env *e, Val *fun, Val *s, Symval ***r, size_t *n) {
+	/* push on r the bindings in e of the symbols of s free in fun, 
+	 * not yet in fun's frame nor in r */
+	Frame *f = fun->symf.cap;
+	for (size_t i=0; i<s->seq.v.n; ++i) {
+		Val *c = s->seq.v.v[i];
+		if (c->hdr.t == VSEQ || c->hdr.t == VLST) {
+			free_syms(e, fun, c, r, n);
+			continue;
+		}
+		if (c->hdr.t != VSYM) {
+			continue;
+		}
+		/* 'it resolved later, at fun execution */
+		if (strncmp(c->sym.v, IT, sizeof(c->sym.v)) == 0) {
+			continue;
+		}
+		/* skip recursive call */
+		if (strncmp(c->sym.v, fun->symf.name, sizeof(c->sym.v)) == 0) {
+			continue;
+		}
+		/* ignore function parameters */
+		if (position(c, fun->symf.param) != -1) {
+			continue;
+		}
+		if ((f != NULL && known_sym(f->s, f->n, c->sym.v)) 
+				|| known_sym(*r, *n, c->sym.v)) {
+			continue;
+		}
+		Symval *sv = lookup_id(e, c->sym.v, true, NULL);
+		/* unknown sym, can be normal, determined in function or operator */
+		if (sv == NULL) {
+			continue;
+		}
+		*r = realloc(*r, (*n + 1) * sizeof(**r));
+		assert(*r != NULL);
+		(*r)[(*n)++] = sv;
+	}
+}
+static void 
+capture_freesym(Env *e, Val *fun, Val *s) {
+	/* add to fun's frame the bindings of the symbols of s known in e: 
+	 * held, not copied, envs copy a binding they write once held */
+	Symval **r = NULL;
+	size_t n = 0;
+	free_syms(e, fun, s, &r, &n);
+	if (n == 0) {
+		return;
+	}
+	Frame *f = fun->symf.cap;
+	if (f == NULL || __atomic_load_n(&f->refs, __ATOMIC_ACQUIRE) != 1) {
+		/* shared with copies: the new frame holds the same bindings */
+		Frame *g = malloc(sizeof(*g));
+		assert(g != NULL);
+		g->refs = 1;
+		g->n = f != NULL ? f->n : 0;
+		g->s = malloc((g->n + n) * sizeof(*g->s));
+		assert(g->s != NULL);
+		for (size_t k=0; k<g->n; ++k) {
+			g->s[k] = ref_symval(f->s[k]);
+		}
+		free_frame(f);
+		fun->symf.cap = f = g;
+	} else {
+		f->s = realloc(f->s, (f->n + n) * sizeof(*f->s));
+		assert(f->s != NULL);
+	}
+	for (size_t k=0; k<n; ++k) {
+		f->s[f->n++] = ref_symval(r[k]);
+	}
+	free(r);
+}
+
+static bool
+isfold_op(Val *a) {
+	/* operators without effects, folded on literals */
+	if (a->hdr.t != VOPE) {
+		return false;
+	}
+	Ires (*op)(Env *, Val *, size_t) = a->symop.v;
+	return op == op_plu || op == op_min || op == op_mul || op == op_div
+		|| op == op_les || op == op_leq || op == op_gre || op == op_geq
+		|| op == op_eq || op == op_neq 
+		|| op == op_not || op == op_and || op == op_or;
+}
+static bool
+foldable(Val *a) {
+	/* a: numbers between binary operators, 'not before a natural, 
+	 * and nothing that would fail (division by 0, logic on reals) */
+	bool opd = true, logic = false, div = false, zero = false, nat = true;
+	size_t nop = 0;
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		Val *b = a->seq.v.v[i];
+		if (opd && isfold_op(b) && b->symop.v == op_not) {
+			logic = true;
+			++nop;
+		} else if (opd && (b->hdr.t == VNAT || b->hdr.t == VREA 
+				|| b->hdr.t == VBIG)) {
+			zero |= (b->hdr.t == VNAT && b->nat.v == 0) 
+				|| (b->hdr.t == VREA && b->rea.v == 0);
+			nat &= b->hdr.t == VNAT;
+			opd = false;
+		} else if (!opd && isfold_op(b) && b->symop.v != op_not) {
+			logic |= b->symop.v == op_and || b->symop.v == op_or;
+			div |= b->symop.v == op_div;
+			++nop;
+			opd = true;
+		} else {
+			return false;
+		}
+	}
+	return !opd && nop > 0 && !(div && zero) && !(logic && !nat);
+}
+static Val *
+opt_seq(Env *e, Val *f, Val *a, size_t *nres, size_t *nfold) {
+	/* rem: a's operators and functions resolved, literal 
+	 * sub-sequences folded, in place; a's value if a folds too */
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		Val *b = a->seq.v.v[i];
+		if (b->hdr.t == VSEQ || b->hdr.t == VLST) {
+			Val *c = opt_seq(e, f, b, nres, nfold);
+			if (c != NULL) {
+				free_v(b);
+				a->seq.v.v[i] = c;
+			}
+		}
+	}
+	size_t nsym = 0;
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		nsym += a->seq.v.v[i]->hdr.t == VSYM;
+	}
+	solve_fun(e, a, f->symf.param);
+	for (size_t i=0; i < a->seq.v.n; ++i) {
+		nsym -= a->seq.v.v[i]->hdr.t == VSYM;
+	}
+	*nres += nsym;
+	if (a->hdr.t != VSEQ || !foldable(a)) {
+		return NULL;
+	}
+	Val *c = copy_v(a);
+	Ires rc = reduce_seq(e, c);
+	Val *r = NULL;
+	if (rc.code != FAIL && rc.code != BACK && c->seq.v.n == 1) {
+		vtype t = c->seq.v.v[0]->hdr.t;
+		if (t == VNAT || t == VREA || t == VBIG) {
+			r = copy_v(c->seq.v.v[0]);
+			++(*nfold);
+		}
+	}
+	free_v(c);
+	return r;
+}
+static bool
+opt_line(Env *e, Val *f, Val *s) {
+	/* s, a line of f's body, optimized in place; 
+	 * false if s can be dropped */
+	if (s->hdr.t != VSEQ) {
+		return true;
+	}
+	if (s->seq.v.n > 0 && s->seq.v.v[0]->hdr.t == VOPE 
+			&& s->seq.v.v[0]->symop.v == op_rem) {
+		if (Dbg) { outf("# opt: `%s line %zu: rem: dropped\n", f->symf.name, f->symf.body.n); }
+		return false;
+	}
+	size_t nres = 0, nfold = 0;
+	Val *r = opt_seq(e, f, s, &nres, &nfold);
+	if (r != NULL) {
+		for (size_t i=0; i < s->seq.v.n; ++i) {
+			free_v(s->seq.v.v[i]);
+		}
+		s->seq.v.v[0] = r;
+		s->seq.v.n = 1;
+	}
+	if (Dbg && (nres > 0 || nfold > 0)) { 
+		outf("# opt: `%s line %zu: %zu resolved, %zu folded: ", 
+				f->symf.name, f->symf.body.n, nres, nfold); 
+		printx_v(s, false, ""); outf("\n"); 
+	}
+	return true;
+}
+static Ires
+eval_fun_body(Env *e, Val *s, size_t p) {
+	Val *fun = lookup(e, ITNAME, false, false);
+	if (fun == NULL) {
+		outf("? %s: 'it undefined\n", __FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	if (fun->hdr.t != VFUN) {
+		outf("? %s: no function under definition\n", __FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	/* capture free symbols' env binding, in the frame of the 
+	 * function under definition, its only holder until `end */
+	capture_freesym(e, fun, s);
+	Val *fret = copy_v(fun);
+	if (Opt && !opt_line(e, fret, s)) {
+		free_v(s);
+		return (Ires) {OK, fret};
+	}
+	fret->symf.body = push_l(fret->symf.body, s);
+	free_code(fret->symf.code);
+	fret->symf.code = NULL;
+	return (Ires) {OK, fret};
+}
+
+static Ires
+eval_loop_body(Env *e, Val *s, size_t p) {
+	Val *loop = lookup(e, ITNAME, false, false);
+	if (loop == NULL) {
+		outf("? %s: 'it required, yet undefined\n", __FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	if (loop->hdr.t != VFUN) {
+		outf("? %s: 'it is not a `loop function\n", __FUNCTION__);
+		return (Ires) {FAIL, s};
+	}
+	Val *lret = copy_v(loop);
+	lret->symf.body = push_l(lret->symf.body, s);
+	free_code(lret->symf.code);
+	lret->symf.code = NULL;
+	return (Ires) {OK, lret};
+}
+static Ires
+eval_maybe_def(Env *e, Val *a) {
+	/* returns a val, if new, freed 'a */
+	/* resolve symbols (not 'it) to operators and functions */
+	Ires rc = solve_top(e, a, false);
+	if (rc.code != OK) {
+		rc.code = FAIL;
+		return rc;
+	}
+	/* rem: expecting end 'foo */
+	if (a->seq.v.v[0]->hdr.t == VOPE 
+			&& a->seq.v.v[0]->symop.v == op_end
+			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
+			&& a->seq.v.v[1]->hdr.t == VSYM) {
+		Ires rc = eval_run(e, a, false, false);
+		/* if an end 'fun: */
+		if (rc.code != BACK) {
+			// OK, FAIL
+			return rc;
+		}
+	}
+	/* default: add to body instead */
+	rc = eval_fun_body(e, a, 0);
+	if (rc.code == OK) {
+		/* distinguish from OK above in end 'fun :*/
+		rc.code = DEF;
+	}
+	return rc;
+}
+
+static Ires
+eval_maybe_loop(Env *e, Val *a) {
+	/* returns a val, if new, freed 'a */
+	/* resolve symbols (not 'it) to operators and functions */
+	Ires rc = solve_top(e, a, false);
+	if (rc.code != OK) {
+		rc.code = FAIL;
+		return rc;
+	}
+	Val *lnst = lookup(e, LOOPNEST, false, false);
+	if (lnst == NULL) {
+		outf("? %s: nested loop count missing\n", __FUNCTION__);
+		return (Ires) {FAIL, a};
+	}
+	if (lnst->hdr.t != VNAT) {
+		outf("? %s: nested loop count invalid\n", __FUNCTION__);
+		return (Ires) {FAIL, a};
+	}
+	/* rem: handle nested loop, another `loop val */
+	if (a->seq.v.v[0]->hdr.t == VOPE 
+			&& a->seq.v.v[0]->symop.v == op_loop) {
+		++(lnst->nat.v);
+	} /* rem: `end `loop ? */
+	else if (a->seq.v.v[0]->hdr.t == VOPE 
+			&& a->seq.v.v[0]->symop.v == op_end
+			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
+			&& a->seq.v.v[1]->hdr.t == VOPE 
+			&& a->seq.v.v[1]->symop.v == op_loop) {
+		/* `end `loop while in topmost loop, execute this */
+		if (lnst->nat.v == 0) {
+			Ires rc = eval_run(e, a, false, false);
+			return rc;
+		}
+		--(lnst->nat.v);
+		/* then proceed to add to body */
+	}
+	rc = eval_loop_body(e, a, 0);
+	if (rc.code == OK) {
+		/* distinguish from eval_run above: */
+		rc.code = LOOP;
+	}
+	return rc;
+}
+static Ires
+eval_maybe_skip(Env *e, Val *a) {
+	/* returns a val, if new, freed 'a */
+	Ires rc = solve_top(e, a, true);
+	if (rc.code != OK) {
+		rc.code = FAIL;
+		return rc;
+	}
+	bool an_endif = a->seq.v.v[0]->hdr.t == VOPE 
+			&& a->seq.v.v[0]->symop.v == op_end
+			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
+			&& a->seq.v.v[1]->hdr.t == VOPE 
+			&& a->seq.v.v[1]->symop.v == op_if ;
+	bool an_else = a->seq.v.v[0]->hdr.t == VOPE 
+			&& a->seq.v.v[0]->symop.v == op_else ;
+	if (an_endif || an_else) {
+		Ires rc = eval_run(e, a, false, false);
+		return rc;
+	}
+	/* default: skip */
+	Val *it = lookup(e, ITNAME, false, false);
+	if (it == NULL) {
+		outf("? %s: 'it undefined\n", __FUNCTION__);
+		return (Ires) {FAIL, a};
+	}
+	free_v(a);
+	return (Ires) {NOP, copy_v(it)};
+}
+
+static bool set_state(Env *e, Ires rc);
+
+static bool  
+transition(Env *e, Val *a) {
+	/* a's execution updates env 'e.
+	 * frees 'a, updates env's state, sets 'it, returns success indicator
+	 */
+	assert(e != NULL && "env is null");
+	assert(a != NULL && "value is null");
+	if (Trace & EVTRANS) { trace_ev(EVTRANS, e->state, a->hdr.t == VSEQ ? a->seq.v.n : 1, e->id, NULL); }
+	if (stopped()) {
+		/* a limit hit: the phrase ends, its values freed */
+		free_v(a);
+		e->state = FATAL;
+		return false;
+	}
+	/* do something (with a) */
+	Ires rc;
+	switch (e->state) {
+		/* following eval_*() must keep only one val alloc'd */
+		case RUN:
+			rc = eval_run(e, a, false, true);
+			break;
+		case LOOPDEF:
+			rc = eval_maybe_loop(e, a);
+			/* if ended a loop definition, execute it now */
+			if (rc.code == OK) {
+				Val *l = rc.v;
+				rc = eval_loop(e, l);
+				free_v(l);
+			}
+			break;
+		case FUNDEF:
+			rc = eval_maybe_def(e, a);
+			break;
+		case IFSKIP:
+			rc = eval_maybe_skip(e, a);
+			break;
+		default:
+			outf("? %s: invalid state\n", __FUNCTION__);
+			e->state = FATAL;
+			return false;
+	}
+	return set_state(e, rc);
+}
+static bool
+set_state(Env *e, Ires rc) {
+	/* e's next state after rc, 'it set to rc's val */
+	istate st = e->state;
+	/* transition state */
+	switch (rc.code) {
+		case FAIL:
+			e->state = FATAL;
+			free_v(rc.v);
+			break;
+		case NOP: /* did nothing */
+			break;
+		case OK: /* did something */
+			if (e->state == IFSKIP 
+					|| e->state == FUNDEF 
+					|| e->state == LOOPDEF) {
+				e->state = RUN;
+			}
+			break;
+		case SKIP:
+			e->state = IFSKIP;
+			break;
+		case DEF:
+			e->state = FUNDEF;
+			break;
+		case RET:
+			e->state = RETURN;
+			break;
+		case LOOP:
+			e->state = LOOPDEF;
+			break;
+		case INT:
+			e->state = STOP;
+			break;
+		default:
+			/* BACK is invalid for example */
+			outf("? %s: invalid evaluation code\n", __FUNCTION__);
+			e->state = FATAL;
+			free_v(rc.v);
+	}
+	if ((Trace & EVSTATE) && e->state != st) { trace_ev(EVSTATE, st, e->state, rc.code, NULL); }
+	/* react to transition */
+	if (e->state == FATAL) {
+		return false;
+	}
+	/* update env, with 'it */
+	Symval *it = symval(ITNAME, rc.v);
+	free_v(rc.v);
+	if (it == NULL) {
+		e->state = FATAL;
+		return false;
+	}
+	if (!stored_sym(e, it)) {
+		free_symval(it);
+		e->state = FATAL;
+		return false;
+	}
+	return true;
+}
+
+/* --- compiled control flow of stored bodies --- */
+
+static bool
+ishead_v(Val *a, Ires (*op)(Env *, Val *, size_t)) {
+	return a->hdr.t == VSEQ && a->seq.v.n > 0 
+		&& a->seq.v.v[0]->hdr.t == VOPE 
+		&& a->seq.v.v[0]->symop.v == op;
+}
+static bool
+isend_v(Val *a, Ires (*op)(Env *, Val *, size_t)) {
+	/* `end `if or `end `loop */
+	return ishead_v(a, op_end) 
+		&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
+		&& a->seq.v.v[1]->hdr.t == VOPE 
+		&& a->seq.v.v[1]->symop.v == op;
+}
+static bool
+nop_of(Val *a, nop *o) {
+	/* o, if a is a numeric infix operator */
+	if (a->hdr.t != VOPE) {
+		return false;
+	}
+	Ires (*f)(Env *, Val *, size_t) = a->symop.v;
+	if (f == op_plu) { *o = NADD; } 
+	else if (f == op_min) { *o = NSUB; } 
+	else if (f == op_mul) { *o = NMUL; } 
+	else if (f == op_div) { *o = NDIV; } 
+	else if (f == op_les) { *o = NLES; } 
+	else if (f == op_leq) { *o = NLEQ; } 
+	else if (f == op_gre) { *o = NGRE; } 
+	else if (f == op_geq) { *o = NGEQ; } 
+	else { return false; }
+	return true;
+}
+static bool
+isopd_v(Val *a) {
+	return a->hdr.t == VNAT || a->hdr.t == VREA || a->hdr.t == VSYM;
+}
+static fuse
+fuse_of(List_v b, size_t i) {
+	/* idiom starting at line i of b, if any */
+	Val *a = b.v[i];
+	nop o;
+	if (a->hdr.t != VSEQ) {
+		return FNONE;
+	}
+	Val **v = a->seq.v.v;
+	if (a->seq.v.n == 3 && isopd_v(v[0]) && nop_of(v[1], &o) && isopd_v(v[2])
+			&& i+1 < b.n && b.v[i+1]->hdr.t == VSEQ && b.v[i+1]->seq.v.n == 3) {
+		Val **w = b.v[i+1]->seq.v.v;
+		if (ishead_v(b.v[i+1], op_call) 
+				&& w[1]->hdr.t == VSYM && strncmp(w[1]->sym.v, IT, WSZ) == 0
+				&& w[2]->hdr.t == VSYM && strncmp(w[2]->sym.v, IT, WSZ) != 0) {
+			return FSTORE;
+		}
+	}
+	if (a->seq.v.n == 4 && ishead_v(a, op_if) && isopd_v(v[1]) && isopd_v(v[3])
+			&& (nop_of(v[2], &o) || (v[2]->hdr.t == VOPE 
+				&& (v[2]->symop.v == op_eq || v[2]->symop.v == op_neq)))) {
+		return FIF;
+	}
+	return FNONE;
+}
+
+static size_t
+natoms(Val *a) {
+	/* atoms of line a, in its sub-sequences too (not in its lists) */
+	size_t n = 0;
+	for (size_t i=0; i<a->seq.v.n; ++i) {
+		Val *b = a->seq.v.v[i];
+		n += b->hdr.t == VSEQ ? natoms(b) : isplain_v(b);
+	}
+	return n;
+}
+static void
+hold_atoms(Val *h, size_t *k, Val *a) {
+	/* the atoms of line a, as natoms counts them, from h[*k] on */
+	for (size_t i=0; i<a->seq.v.n; ++i) {
+		Val *b = a->seq.v.v[i];
+		if (b->hdr.t == VSEQ) {
+			hold_atoms(h, k, b);
+		} else if (isplain_v(b)) {
+			memcpy(h + *k, b, sizeof(Val));
+			h[(*k)++].hdr.lent = true;
+		}
+	}
+}
+static Val *
+held_line(Val *h, size_t *k, Val *a) {
+	/* line a to be reduced: a fresh sequence over the atoms lent 
+	 * from h[*k] on (see hold_atoms), its other values copied; 
+	 * the sequence drops the lent atoms it consumes, 
+	 * and solve_seq copies one it ends with */
+	Val *b = malloc(sizeof(*b));
+	assert(b != NULL);
+	b->hdr.t = VSEQ;
+	b->seq.h = 0;
+	b->seq.v.n = a->seq.v.n;
+	b->seq.v.v = NULL;
+	if (a->seq.v.n > 0) {
+		b->seq.v.v = malloc(a->seq.v.n * sizeof(Val *));
+		assert(b->seq.v.v != NULL);
+	}
+	for (size_t i=0; i<a->seq.v.n; ++i) {
+		Val *c = a->seq.v.v[i];
+		if (c->hdr.t == VSEQ) {
+			b->seq.v.v[i] = held_line(h, k, c);
+		} else if (isplain_v(c)) {
+			b->seq.v.v[i] = h + (*k)++;
+		} else {
+			b->seq.v.v[i] = copy_v(c);
+		}
+	}
+	return b;
+}
+
+static Code *
+code_of(List_v b) {
+	/* control flow of body b, as the states of transition would 
+	 * find it: a skip from `if or `else ends at the next `else or `end `if
+	 * (skips do not nest), a loop at its matching `end `loop */
+	Code *c = malloc(sizeof(*c));
+	assert(c != NULL);
+	c->refs = 1;
+	c->n = b.n;
+	c->calls = 0;
+	c->jit = NULL;
+	c->to = calloc(b.n > 0 ? b.n : 1, sizeof(*c->to));
+	c->loop = calloc(b.n > 0 ? b.n : 1, sizeof(*c->loop));
+	c->fuse = calloc(b.n > 0 ? b.n : 1, sizeof(*c->fuse));
+	c->held = calloc(b.n > 0 ? b.n : 1, sizeof(*c->held));
+	c->nheld = calloc(b.n > 0 ? b.n : 1, sizeof(*c->nheld));
+	assert(c->to != NULL && c->loop != NULL && c->fuse != NULL);
+	assert(c->held != NULL && c->nheld != NULL);
+	for (size_t i=0; i<b.n; ++i) {
+		site_v(b.v[i]);
+		c->fuse[i] = fuse_of(b, i);
+		c->nheld[i] = natoms(b.v[i]);
+		c->held[i] = malloc((c->nheld[i] > 0 ? c->nheld[i] : 1) * sizeof(Val));
+		assert(c->held[i] != NULL);
+		size_t k = 0;
+		hold_atoms(c->held[i], &k, b.v[i]);
+	}
+	for (size_t i=0; i<b.n; ++i) {
+		if (ishead_v(b.v[i], op_if) || ishead_v(b.v[i], op_else)) {
+			size_t j = i+1;
+			while (j < b.n && !ishead_v(b.v[j], op_else) 
+					&& !isend_v(b.v[j], op_if)) {
+				++j;
+			}
+			c->to[i] = j;
+			continue;
+		}
+		if (!(ishead_v(b.v[i], op_loop) && b.v[i]->seq.v.n == 1)) {
+			continue;
+		}
+		size_t j = i+1;
+		for (size_t nest = 0; j < b.n; ++j) {
+			if (ishead_v(b.v[j], op_loop)) {
+				++nest;
+			} else if (isend_v(b.v[j], op_loop)) {
+				if (nest == 0) {
+					break;
+				}
+				--nest;
+			}
+		}
+		if (j == b.n) {
+			/* unfinished, left to transition */
+			continue;
+		}
+		Val *f = malloc(sizeof(*f));
+		assert(f != NULL);
+		f->hdr.t = VFUN;
+		strncpy(f->symf.name, LOOPNAME, sizeof(f->symf.name));
+		f->symf.param.n = 0;
+		f->symf.param.v = NULL;
+		f->symf.body.n = j-i-1;
+		f->symf.body.v = malloc((j-i) * sizeof(Val *));
+		assert(f->symf.body.v != NULL);
+		for (size_t k=i+1; k<j; ++k) {
+			f->symf.body.v[k-i-1] = copy_v(b.v[k]);
+		}
+		f->symf.cap = NULL;
+		/* built now: shared by pmap workers once built */
+		f->symf.code = code_of(f->symf.body);
+		c->to[i] = j;
+		c->loop[i] = f;
+	}
+	return c;
+}
+
+static size_t
+run_fused(Env *e, Val *f, size_t i) {
+	/* the idiom at line i of f's body, run in e at once: 
+	 * the lines done, or 0 if left to the lines (other values, errors) */
+	Val **v = f->symf.body.v[i]->seq.v.v;
+	bool isif = f->symf.code->fuse[i] == FIF;
+	if (isif) {
+		++v;
+	}
+	Val *a = num_arg(e, v[0]);
+	Val *b = num_arg(e, v[2]);
+	if (a == NULL || b == NULL) {
+		return 0;
+	}
+	okind k = kind_of(a, b);
+	nop o;
+	Val *r;
+	if (nop_of(v[1], &o)) {
+		r = num_fast(o, a, b, k);
+		if (r == NULL) {
+			return 0;
+		}
+	} else {
+		r = malloc(sizeof(*r));
+		assert(r != NULL);
+		r->hdr.t = VNAT;
+		r->hdr.lent = false;
+		r->nat.v = isequal_v(a, b) == (v[1]->symop.v == op_eq);
+	}
+	if (isif) {
+		/* as `if: 'it is 1 or 0, skip if 0 */
+		r->nat.v = istrue_v(r) ? 1 : 0;
+		if (r->nat.v == 0) {
+			e->state = IFSKIP;
+		}
+		set_symval(e, ITNAME, r);
+		return 1;
+	}
+	/* as `call 'it 'x: x must stand for itself, here or new */
+	Val *x = f->symf.body.v[i+1]->seq.v.v[2];
+	size_t id;
+	Symval *sv = lookup_id(e, x->sym.v, false, &id);
+	if (sv != NULL) {
+		if (sv->v->hdr.t == VFUN || sv->v->hdr.t == VOPE || sv->v->hdr.t == VSYM) {
+			free_v(r);
+			return 0;
+		}
+		sv = own_sym(e, id);
+		free_v(sv->v);
+		sv->v = copy_v(r);
+	} else {
+		/* not an operator, nor captured, nor a function */
+		Val *c = NULL;
+		if (isop_sym(x) || lookup_id(e, x->sym.v, false, NULL) != NULL
+				|| ((c = lookup_ic(e, x)) != NULL && (c->hdr.t == VFUN 
+					|| c->hdr.t == VOPE || c->hdr.t == VSYM))) {
+			free_v(r);
+			return 0;
+		}
+		sv = symval(x->sym.v, r);
+		if (sv == NULL || !stored_sym(e, sv)) {
+			free_v(r);
+			return 0;
+		}
+	}
+	set_symval(e, ITNAME, r);
+	return 2;
+}
+
+static bool
+run_body(Env *e, Val *f, bool inloop) {
+	/* one pass over the lines of f's body in e, like eval_ph; 
+	 * skipped lines and the lines of inner loops are jumped over.
+	 * Stops on `return, and on `stop if inloop. */
+	if (f->symf.code == NULL) {
+		f->symf.code = code_of(f->symf.body);
+	}
+	Code *c = f->symf.code;
+	for (size_t i=0; i<f->symf.body.n; ++i) {
+		bool t;
+		size_t k;
+		/* a fused line is a step, if a limit is hit transition fails */
+		if (e->state == RUN && c->fuse[i] != FNONE && !stopped() && (k = run_fused(e, f, i)) > 0) {
+			if (Trace & EVLINE) { trace_ev(EVLINE, 1, i, i+k-1, f->symf.name); }
+			t = true;
+			if (e->state == IFSKIP && c->to[i] > i) {
+				i = c->to[i] - 1;
+			} else {
+				i += k-1;
+			}
+		} else if (e->state == RUN && c->loop[i] != NULL) {
+			/* the loop as collected by LOOPDEF, then run */
+			if (Trace & EVLINE) { trace_ev(EVLINE, 2, i, c->to[i], f->symf.name); }
+			e->state = LOOPDEF;
+			t = set_state(e, eval_loop(e, c->loop[i]));
+			i = c->to[i];
+		} else if (e->state == RUN) {
+			/* reduced over the line's atoms, lent by c */
+			size_t k = 0;
+			Val *v = held_line(c->held[i], &k, f->symf.body.v[i]);
+			if (Trace & EVLINE) { trace_ev(EVLINE, 0, i, i, f->symf.name); }
+			t = transition(e, v);  /* consumes v */
+			if (t && e->state == IFSKIP && c->to[i] > i) {
+				/* to the `else or `end `if, that ends the skip */
+				if (Trace & EVLINE) { trace_ev(EVLINE, 3, i, c->to[i], f->symf.name); }
+				i = c->to[i] - 1;
+			}
+		} else {
+			Val *v = copy_v(f->symf.body.v[i]);
+			if (Trace & EVLINE) { trace_ev(EVLINE, 0, i, i, f->symf.name); }
+			t = transition(e, v);  /* consumes v */
+			if (t && e->state == IFSKIP && c->to[i] > i) {
+				/* to the `else or `end `if, that ends the skip */
+				if (Trace & EVLINE) { trace_ev(EVLINE, 3, i, c->to[i], f->symf.name); }
+				i = c->to[i] - 1;
+			}
+		}
+		if (!t) {
+			return false;
+		}
+		if (e->state == RETURN || (inloop && e->state == STOP)) {
+			break;
+		}
+	}
+	return true;
+}
+
+/* ----- template JIT: numeric functions to x86-64 code ----- 
+ * A function whose body only has numeric operators, comparisons, 
+ * `if, `else, `return, `call and calls to itself is compiled, 
+ * per argument types, once called JITHOT times. The code keeps 
+ * each value in a slot of its frame; on overflow, division by 0, 
+ * a function rebound or its stack below the floor it was given 
+ * (calls too deep), it gives up and the call is interpreted.
+ * Each call it makes counts against the depth limit, and every 
+ * TIMESTEPS calls it checks the deadline and interruptions; 
+ * past a limit it ends, and the interpreted call fails at once.
+ */
+
+#define JITHOT 8
+#define JITARGS 6
+#define JITSLOTS 512
+#define JITSTACK (1 << 20)	/* stack the code may take, in bytes */
+/* jumps forward to the exits, past the lines */
+#define JBAIL SIZE_MAX	/* gives up, 1 */
+#define JOUT (SIZE_MAX - 1)	/* returns what a call to itself did */
+#define JDEEP (SIZE_MAX - 2)	/* below the stack floor, 2 */
+#define JLIMIT (SIZE_MAX - 3)	/* the phrase must end, 3 */
+#define JCALLS (SIZE_MAX - 4)	/* calls too deep, 4 */
+
+#if defined(__x86_64__)
+
+typedef enum {TUNDEF, TNAT, TREA, TBAD} jtype;
+
+typedef struct {
+	size_t at;	/* rel32 to patch */
+	size_t line;	/* to which line's skip entry, or body size for the end */
+} Jpatch;
+
+typedef struct {
+	Val *f;
+	unsigned sig;
+	jtype ret;
+	unsigned char *b;	/* code */
+	size_t n, cap;
+	size_t nslot;
+	size_t ctl;	/* slot of the Jctl */
+	jtype ty[JITSLOTS];	/* of the slots, as the line runs */
+	char (*name)[WSZ];	/* of the named slots (params, locals) */
+	size_t nname;
+	size_t *slotof;	/* of the names */
+	Jpatch *pa;	/* jumps forward */
+	size_t npa;
+	jtype (*skip)[JITSLOTS];	/* types at each line's skip entry */
+	bool *hasskip;
+	const char *why;	/* not compiled because */
+	size_t line;	/* at that line */
+} Jc;
+
+/* jit item: an operand in a slot, an operator, 
+ * a list (arguments), the function itself, a new name */
+typedef enum {JOPD, JOPE, JLST, JSELF, JNAME} jkind;
+
+typedef struct {
+	jkind k;
+	size_t slot;
+	jtype t;
+	const char *sym;	/* name of the operand as written, or NULL */
+	Ires (*op)(Env *, Val *, size_t);
+	int prio;
+	int arity;
+	Val *lst;
+} Jitem;
+
+#define ITSLOT(j) ((j)->f->symf.param.n)
+
+static void
+jc_b(Jc *j, const unsigned char *a, size_t n) {
+	if (j->n + n > j->cap) {
+		j->cap = 2 * (j->n + n) + 256;
+		j->b = realloc(j->b, j->cap);
+		assert(j->b != NULL);
+	}
+	memcpy(j->b + j->n, a, n);
+	j->n += n;
+}
+#define JB(j, ...) do { \
+	const unsigned char b_[] = {__VA_ARGS__}; \
+	jc_b(j, b_, sizeof(b_)); \
+} while (0)
+
+static void
+jc_32(Jc *j, int32_t a) {
+	jc_b(j, (unsigned char *)&a, 4);
+}
+static int32_t
+jc_disp(size_t slot) {
+	/* below the saved rbp, rbx, r12 */
+	return -24 - 8 * (int32_t)slot;
+}
+static void
+jc_mem(Jc *j, const unsigned char *op, size_t n, int reg, size_t slot) {
+	/* op reg, [rbp + disp32] */
+	jc_b(j, op, n);
+	JB(j, 0x80 | (reg << 3) | 5);
+	jc_32(j, jc_disp(slot));
+}
+#define JM(j, reg, slot, ...) do { \
+	const unsigned char b_[] = {__VA_ARGS__}; \
+	jc_mem(j, b_, sizeof(b_), reg, slot); \
+} while (0)
+
+/* registers in ModRM reg fields */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RSI 6
+#define RDI 7
+
+static size_t
+jc_slot(Jc *j, jtype t) {
+	if (j->nslot >= JITSLOTS) {
+		j->why = "too many values";
+		return 0;
+	}
+	j->ty[j->nslot] = t;
+	return j->nslot++;
+}
+static size_t
+jc_jump(Jc *j, size_t line) {
+	/* records the rel32 just emitted, to patch for line's skip entry */
+	j->pa = realloc(j->pa, (j->npa + 1) * sizeof(*j->pa));
+	assert(j->pa != NULL);
+	j->pa[j->npa++] = (Jpatch) {j->n - 4, line};
+	return j->npa;
+}
+static void
+jc_skipto(Jc *j, size_t line) {
+	/* the types as the jump to line's skip entry leaves */
+	if (!j->hasskip[line]) {
+		memcpy(j->skip[line], j->ty, sizeof(j->ty));
+		j->hasskip[line] = true;
+		return;
+	}
+	for (size_t i=0; i<JITSLOTS; ++i) {
+		if (j->skip[line][i] != j->ty[i]) {
+			j->skip[line][i] = TBAD;
+		}
+	}
+}
+static void
+jc_land(Jc *j, size_t line) {
+	/* patch the jumps to line's skip entry to here */
+	for (size_t i=0; i<j->npa; ++i) {
+		if (j->pa[i].line == line) {
+			int32_t d = (int32_t)(j->n - (j->pa[i].at + 4));
+			memcpy(j->b + j->pa[i].at, &d, 4);
+		}
+	}
+}
+
+static long
+jc_name(Jc *j, const char *a) {
+	/* its last slot */
+	for (size_t i=j->nname; i-- > 0; ) {
+		if (strncmp(j->name[i], a, WSZ) == 0) {
+			return (long)j->slotof[i];
+		}
+	}
+	return -1;
+}
+static size_t
+jc_addname(Jc *j, const char *a, jtype t) {
+	size_t s = jc_slot(j, t);
+	j->name = realloc(j->name, (j->nname + 1) * sizeof(*j->name));
+	j->slotof = realloc(j->slotof, (j->nname + 1) * sizeof(*j->slotof));
+	assert(j->name != NULL && j->slotof != NULL);
+	strncpy(j->name[j->nname], a, WSZ);
+	j->slotof[j->nname++] = s;
+	return s;
+}
+static Val *
+jc_captured(Jc *j, const char *a) {
+	Frame *c = j->f->symf.cap;
+	for (size_t i=0; c != NULL && i<c->n; ++i) {
+		if (strncmp(c->s[i]->name, a, WSZ) == 0) {
+			return c->s[i]->v;
+		}
+	}
+	return NULL;
+}
+
+static size_t
+jc_const(Jc *j, Val *a) {
+	size_t s = jc_slot(j, a->hdr.t == VNAT ? TNAT : TREA);
+	int64_t x;
+	memcpy(&x, a->hdr.t == VNAT ? (void *)&a->nat.v : (void *)&a->rea.v, 8);
+	JB(j, 0x48, 0xB8);	/* mov rax, imm64 */
+	jc_b(j, (unsigned char *)&x, 8);
+	JM(j, RAX, s, 0x48, 0x89);	/* mov [s], rax */
+	return s;
+}
+static size_t
+jc_real(Jc *j, size_t s, jtype t) {
+	/* s as a real, converted into a new slot if a natural */
+	if (t == TREA) {
+		return s;
+	}
+	size_t r = jc_slot(j, TREA);
+	JM(j, 0, s, 0xF2, 0x48, 0x0F, 0x2A);	/* cvtsi2sd xmm0, [s] */
+	JM(j, 0, r, 0xF2, 0x0F, 0x11);	/* movsd [r], xmm0 */
+	return r;
+}
+
+static bool jc_seq(Jc *j, Val *a, size_t line, Jitem *r);
+
+static bool
+jc_value(Jc *j, Val *a, Jitem *r) {
+	/* a list element, as solve_lst: to its value */
+	if (a->hdr.t == VSEQ) {
+		return jc_seq(j, a, SIZE_MAX, r) && r->k == JOPD;
+	}
+	if (a->hdr.t == VNAT || a->hdr.t == VREA) {
+		*r = (Jitem) {JOPD, jc_const(j, a), a->hdr.t == VNAT ? TNAT : TREA};
+		return true;
+	}
+	if (a->hdr.t != VSYM || lookup_op(a->sym.v) != NULL) {
+		j->why = "list element";
+		return false;
+	}
+	if (strncmp(a->sym.v, IT, WSZ) == 0) {
+		*r = (Jitem) {JOPD, ITSLOT(j), j->ty[ITSLOT(j)]};
+		return true;
+	}
+	long s = jc_name(j, a->sym.v);
+	if (s >= 0) {
+		*r = (Jitem) {JOPD, s, j->ty[s]};
+		return true;
+	}
+	Val *c = jc_captured(j, a->sym.v);
+	if (c != NULL && (c->hdr.t == VNAT || c->hdr.t == VREA)) {
+		*r = (Jitem) {JOPD, jc_const(j, c), c->hdr.t == VNAT ? TNAT : TREA};
+		return true;
+	}
+	j->why = "unknown symbol";
+	return false;
+}
+
+static bool
+jc_item(Jc *j, Val *a, Jitem *r) {
+	/* a seq element, as solve_seq */
+	switch (a->hdr.t) {
+		case VNAT:
+		case VREA:
+		case VSEQ:
+			return jc_value(j, a, r);
+		case VLST:
+			*r = (Jitem) {JLST};
+			r->lst = a;
+			return true;
+		case VOPE:
+			*r = (Jitem) {JOPE};
+			r->op = a->symop.v;
+			r->prio = a->symop.prio;
+			r->arity = a->symop.arity;
+			return true;
+		case VSYM: {
+			const Symop *so = lookup_op(a->sym.v);
+			if (so != NULL) {
+				*r = (Jitem) {JOPE};
+				r->op = so->f;
+				r->prio = so->prio;
+				r->arity = so->arity;
+				return true;
+			}
+			if (strncmp(a->sym.v, IT, WSZ) != 0 && jc_name(j, a->sym.v) < 0 
+					&& jc_captured(j, a->sym.v) == NULL) {
+				/* the function itself, or a name `call may give */
+				*r = (Jitem) {JNAME};
+				if (strncmp(a->sym.v, j->f->symf.name, WSZ) == 0) {
+					r->k = JSELF;
+				}
+				r->sym = a->sym.v;
+				return true;
+			}
+			if (!jc_value(j, a, r)) {
+				return false;
+			}
+			if (strncmp(a->sym.v, IT, WSZ) != 0) {
+				r->sym = a->sym.v;
+			}
+			return true;
+		}
+		default:
+			j->why = "value type";
+			return false;
+	}
+}
+
+static bool
+jc_num(Jc *j, Jitem *x, Ires (*op)(Env *, Val *, size_t), Jitem *y, Jitem *r) {
+	/* x op y into a new slot, as num_scalar */
+	if ((x->t != TNAT && x->t != TREA) || (y->t != TNAT && y->t != TREA)) {
+		j->why = "operand type";
+		return false;
+	}
+	bool cmp = op == op_les || op == op_leq || op == op_gre || op == op_geq
+		|| op == op_eq || op == op_neq;
+	if (x->t == TNAT && y->t == TNAT) {
+		size_t s = jc_slot(j, TNAT);
+		JM(j, RAX, x->slot, 0x48, 0x8B);	/* mov rax, [x] */
+		if (op == op_plu) {
+			JM(j, RAX, y->slot, 0x48, 0x03);	/* add rax, [y] */
+		} else if (op == op_min) {
+			JM(j, RAX, y->slot, 0x48, 0x2B);	/* sub rax, [y] */
+		} else if (op == op_mul) {
+			JM(j, RAX, y->slot, 0x48, 0x0F, 0xAF);	/* imul rax, [y] */
+		} else if (op == op_div) {
+			JM(j, RCX, y->slot, 0x48, 0x8B);	/* mov rcx, [y] */
+			JB(j, 0x48, 0x85, 0xC9);	/* test rcx, rcx */
+			JB(j, 0x0F, 0x84); jc_32(j, 0); jc_jump(j, JBAIL);	/* jz bail */
+			JB(j, 0x48, 0x83, 0xF9, 0xFF);	/* cmp rcx, -1 */
+			JB(j, 0x75, 0x13);	/* jne +19 */
+			JB(j, 0x48, 0xBA, 0, 0, 0, 0, 0, 0, 0, 0x80);	/* mov rdx, LLONG_MIN */
+			JB(j, 0x48, 0x39, 0xD0);	/* cmp rax, rdx */
+			JB(j, 0x0F, 0x84); jc_32(j, 0); jc_jump(j, JBAIL);	/* je bail */
+			JB(j, 0x48, 0x99);	/* cqo */
+			JB(j, 0x48, 0xF7, 0xF9);	/* idiv rcx */
+		} else {
+			unsigned char cc = op == op_les ? 0x9C : op == op_leq ? 0x9E 
+				: op == op_gre ? 0x9F : op == op_geq ? 0x9D 
+				: op == op_eq ? 0x94 : 0x95;
+			JM(j, RAX, y->slot, 0x48, 0x3B);	/* cmp rax, [y] */
+			JB(j, 0x0F, cc, 0xC0);	/* setcc al */
+			JB(j, 0x0F, 0xB6, 0xC0);	/* movzx eax, al */
+		}
+		if (op == op_plu || op == op_min || op == op_mul) {
+			/* past long long: a big natural, interpreted */
+			JB(j, 0x0F, 0x80); jc_32(j, 0); jc_jump(j, JBAIL);	/* jo bail */
+		}
+		JM(j, RAX, s, 0x48, 0x89);	/* mov [s], rax */
+		*r = (Jitem) {JOPD, s, TNAT};
+		return true;
+	}
+	if (op == op_eq || op == op_neq) {
+		j->why = "equality of reals";
+		return false;
+	}
+	size_t a = jc_real(j, x->slot, x->t);
+	size_t b = jc_real(j, y->slot, y->t);
+	size_t s = jc_slot(j, cmp ? TNAT : TREA);
+	if (cmp) {
+		/* unordered (NaN) compares false, as in C */
+		bool swap = op == op_les || op == op_leq;
+		JM(j, 0, swap ? b : a, 0xF2, 0x0F, 0x10);	/* movsd xmm0, [.] */
+		JM(j, 0, swap ? a : b, 0x66, 0x0F, 0x2E);	/* ucomisd xmm0, [.] */
+		unsigned char cc = (op == op_les || op == op_gre) ? 0x97 : 0x93;
+		JB(j, 0x0F, cc, 0xC0);	/* seta/setae al */
+		JB(j, 0x0F, 0xB6, 0xC0);	/* movzx eax, al */
+		JM(j, RAX, s, 0x48, 0x89);	/* mov [s], rax */
+		*r = (Jitem) {JOPD, s, TNAT};
+		return true;
+	}
+	if (op == op_div) {
+		JB(j, 0x66, 0x0F, 0x57, 0xC9);	/* xorpd xmm1, xmm1 */
+		JM(j, 1, b, 0x66, 0x0F, 0x2E);	/* ucomisd xmm1, [b] */
+		JB(j, 0x0F, 0x84); jc_32(j, 0); jc_jump(j, JBAIL);	/* je bail */
+	}
+	unsigned char o = op == op_plu ? 0x58 : op == op_min ? 0x5C 
+		: op == op_mul ? 0x59 : 0x5E;
+	JM(j, 0, a, 0xF2, 0x0F, 0x10);	/* movsd xmm0, [a] */
+	JM(j, 0, b, 0xF2, 0x0F, o);	/* op xmm0, [b] */
+	JM(j, 0, s, 0xF2, 0x0F, 0x11);	/* movsd [s], xmm0 */
+	*r = (Jitem) {JOPD, s, TREA};
+	return true;
+}
+
+static bool
+jc_self(Jc *j, Val *l, Jitem *r) {
+	/* call to the function itself, with the values of list l */
+	size_t np = j->f->symf.param.n;
+	if (l->lst.v.n != np) {
+		j->why = "call arity";
+		return false;
+	}
+	Jitem *x = malloc((np > 0 ? np : 1) * sizeof(*x));
+	assert(x != NULL);
+	for (size_t i=0; i<np; ++i) {
+		if (!jc_value(j, l->lst.v.v[i], x+i)) {
+			free(x);
+			return false;
+		}
+		if (x[i].t != ((j->sig >> i) & 1 ? TREA : TNAT)) {
+			j->why = "call argument types";
+			free(x);
+			return false;
+		}
+	}
+	/* arguments in rising addresses: slots taken downward */
+	size_t a0 = j->nslot;
+	for (size_t i=0; i<np; ++i) {
+		jc_slot(j, x[np-1-i].t);
+	}
+	for (size_t i=0; i<np; ++i) {
+		JM(j, RAX, x[i].slot, 0x48, 0x8B);	/* mov rax, [x] */
+		JM(j, RAX, a0 + np-1-i, 0x48, 0x89);	/* mov [arg i], rax */
+	}
+	free(x);
+	size_t s = jc_slot(j, j->ret);
+	JM(j, RDI, np > 0 ? a0 + np-1 : s, 0x48, 0x8D);	/* lea rdi, [args] */
+	JM(j, RSI, s, 0x48, 0x8D);	/* lea rsi, [s] */
+	JM(j, RDX, j->ctl, 0x48, 0x8B);	/* mov rdx, [ctl] */
+	JB(j, 0xE8); jc_32(j, -(int32_t)(j->n + 4));	/* call start */
+	JB(j, 0x85, 0xC0);	/* test eax, eax */
+	JB(j, 0x0F, 0x85); jc_32(j, 0); jc_jump(j, JOUT);	/* jnz out */
+	*r = (Jitem) {JOPD, s, j->ret};
+	return true;
+}
+
+static bool
+jc_seq(Jc *j, Val *a, size_t line, Jitem *r) {
+	/* a seq reduced as reduce_seq does: the leftmost of the operators 
+	 * of highest priority first; line is that of a top level seq,
+	 * for `if and `call, else SIZE_MAX */
+	if (a->hdr.t != VSEQ) {
+		return jc_item(j, a, r);
+	}
+	size_t n = a->seq.v.n;
+	if (n == 0) {
+		j->why = "empty sequence";
+		return false;
+	}
+	Jitem *it = malloc(n * sizeof(*it));
+	assert(it != NULL);
+	bool ok = true;
+	for (size_t i=0; ok && i<n; ++i) {
+		ok = jc_item(j, a->seq.v.v[i], it+i);
+	}
+	while (ok && (n > 1 || (it[0].k == JOPE && it[0].arity == 0))) {
+		size_t p = 0;
+		int hi = INT_MAX;
+		for (size_t i=0; i<n; ++i) {
+			int pr = it[i].k == JSELF ? FUNDEFPRIO 
+				: (it[i].k == JOPE ? it[i].prio : INT_MAX);
+			if (pr < hi) {
+				hi = pr;
+				p = i;
+			}
+		}
+		Ires (*op)(Env *, Val *, size_t) = it[p].op;
+		Jitem c;
+		size_t from, to;	/* items replaced by c */
+		if (hi == INT_MAX) {
+			j->why = "sequence without function";
+			ok = false;
+		} else if (it[p].k == JSELF) {
+			ok = p+1 < n && it[p+1].k == JLST && jc_self(j, it[p+1].lst, &c);
+			from = p, to = p+1;
+		} else if (op == op_plu || op == op_min || op == op_mul || op == op_div
+				|| op == op_les || op == op_leq || op == op_gre || op == op_geq
+				|| op == op_eq || op == op_neq) {
+			ok = p > 0 && p < n-1 && it[p-1].k == JOPD && it[p+1].k == JOPD
+				&& jc_num(j, it+p-1, op, it+p+1, &c);
+			from = p-1, to = p+1;
+		} else if (op == op_if && p == 0 && n == 2 && it[1].k == JOPD 
+				&& it[1].t == TNAT && line != SIZE_MAX) {
+			/* 'it is the condition's truth; if false, skip */
+			size_t s = jc_slot(j, TNAT);
+			JM(j, 7, it[1].slot, 0x48, 0x83); JB(j, 0);	/* cmp qword [x], 0 */
+			JB(j, 0x0F, 0x95, 0xC0);	/* setne al */
+			JB(j, 0x0F, 0xB6, 0xC0);	/* movzx eax, al */
+			JM(j, RAX, s, 0x48, 0x89);	/* mov [s], rax */
+			JM(j, RAX, ITSLOT(j), 0x48, 0x89);	/* mov [it], rax */
+			j->ty[ITSLOT(j)] = TNAT;
+			JB(j, 0x85, 0xC0);	/* test eax, eax */
+			size_t tl = j->f->symf.code->to[line];
+			JB(j, 0x0F, 0x84); jc_32(j, 0); jc_jump(j, tl);	/* jz skip */
+			jc_skipto(j, tl);
+			c = (Jitem) {JOPD, s, TNAT};
+			from = 0, to = 1;
+		} else if (op == op_call && p == 0 && n == 3 && line != SIZE_MAX
+				&& it[1].k == JOPD && (it[2].k == JOPD || it[2].k == JNAME) 
+				&& it[2].sym != NULL
+				&& jc_captured(j, it[2].sym) == NULL) {
+			/* local variable, a new slot if new or of another type */
+			long s = jc_name(j, it[2].sym);
+			if (s < 0 || j->ty[s] != it[1].t) {
+				s = jc_addname(j, it[2].sym, it[1].t);
+			}
+			JM(j, RAX, it[1].slot, 0x48, 0x8B);	/* mov rax, [x] */
+			JM(j, RAX, s, 0x48, 0x89);	/* mov [s], rax */
+			j->ty[s] = it[1].t;
+			c = (Jitem) {JOPD, s, it[1].t};
+			from = 0, to = 2;
+		} else {
+			j->why = "operator";
+			ok = false;
+		}
+		if (ok && j->why != NULL) {
+			ok = false;
+		}
+		if (!ok) {
+			break;
+		}
+		it[from] = c;
+		memmove(it+from+1, it+to+1, (n-to-1) * sizeof(*it));
+		n -= to - from;
+	}
+	if (ok && it[0].k != JOPD) {
+		j->why = "not a value";
+		ok = false;
+	}
+	if (ok) {
+		*r = it[0];
+	}
+	free(it);
+	return ok;
+}
+
+static int
+jit_tick(Jctl *a) {
+	/* called by native code every TIMESTEPS calls: 1 if it must end */
+	a->ticks = TIMESTEPS;
+	return limits_now();
+}
+
+static bool
+jc_body(Jc *j) {
+	/* the lines of the body, as run_body runs them */
+	List_v b = j->f->symf.body;
+	Code *code = j->f->symf.code;
+	size_t np = j->f->symf.param.n;
+	/* prologue: push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, imm32 */
+	JB(j, 0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x48, 0x81, 0xEC);
+	size_t frame = j->n;
+	jc_32(j, 0);
+	JB(j, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4);	/* mov rbx, rdi; mov r12, rsi */
+	for (size_t i=0; i<np; ++i) {
+		jc_addname(j, j->f->symf.param.v[i]->sym.v, (j->sig >> i) & 1 ? TREA : TNAT);
+		JB(j, 0x48, 0x8B, 0x83); jc_32(j, 8*i);	/* mov rax, [rbx + 8i] */
+		JM(j, RAX, i, 0x48, 0x89);	/* mov [param], rax */
+	}
+	jc_slot(j, TUNDEF);	/* 'it */
+	j->ctl = jc_slot(j, TUNDEF);
+	JM(j, RDX, j->ctl, 0x48, 0x89);	/* mov [ctl], rdx */
+	/* a call more: within depth, above the floor, and at times limits checked */
+	JB(j, 0x48, 0xFF, 0x4A, 16);	/* dec qword [rdx+16] */
+	JB(j, 0x0F, 0x88); jc_32(j, 0); jc_jump(j, JCALLS);	/* js calls */
+	JB(j, 0x48, 0x3B, 0x22);	/* cmp rsp, [rdx] */
+	JB(j, 0x0F, 0x82); jc_32(j, 0); jc_jump(j, JDEEP);	/* jb deep */
+	JB(j, 0x48, 0xFF, 0x4A, 8);	/* dec qword [rdx+8] */
+	JB(j, 0x75, 0);	/* jnz past the check */
+	size_t past = j->n;
+	int (*tick)(Jctl *) = jit_tick;
+	JB(j, 0x48, 0x89, 0xD7);	/* mov rdi, rdx */
+	JB(j, 0x48, 0xB8); jc_b(j, (unsigned char *)&tick, 8);	/* mov rax, jit_tick */
+	JB(j, 0xFF, 0xD0);	/* call rax (the stack is aligned) */
+	JB(j, 0x85, 0xC0);	/* test eax, eax */
+	JB(j, 0x0F, 0x85); jc_32(j, 0); jc_jump(j, JLIMIT);	/* jnz limit */
+	j->b[past - 1] = j->n - past;
+	bool live = true;	/* reached from the line before */
+	for (size_t i=0; i<b.n && j->why == NULL; ++i) {
+		Val *a = b.v[i];
+		j->line = i;
+		if (ishead_v(a, op_else) && a->seq.v.n == 1) {
+			if (live) {
+				JB(j, 0xE9); jc_32(j, 0); jc_jump(j, code->to[i]);	/* jmp skip */
+				jc_skipto(j, code->to[i]);
+			}
+			live = j->hasskip[i];
+			if (live) {
+				/* skip ended by `else: 'it is 1 */
+				jc_land(j, i);
+				memcpy(j->ty, j->skip[i], sizeof(j->ty));
+				JB(j, 0x48, 0xC7, 0x85); jc_32(j, jc_disp(ITSLOT(j))); jc_32(j, 1);
+				j->ty[ITSLOT(j)] = TNAT;
+			}
+			continue;
+		}
+		if (isend_v(a, op_if)) {
+			if (j->hasskip[i]) {
+				jc_land(j, i);
+				if (live) {
+					for (size_t k=0; k<JITSLOTS; ++k) {
+						if (j->ty[k] != j->skip[i][k]) {
+							j->ty[k] = TBAD;
+						}
+					}
+				} else {
+					memcpy(j->ty, j->skip[i], sizeof(j->ty));
+				}
+				live = true;
+			}
+			continue;
+		}
+		if (!live) {
+			continue;
+		}
+		if (ishead_v(a, op_return) && a->seq.v.n == 1) {
+			JB(j, 0xE9); jc_32(j, 0); jc_jump(j, b.n);	/* jmp end */
+			jc_skipto(j, b.n);
+			live = false;
+			continue;
+		}
+		if (ishead_v(a, op_rem)) {
+			for (size_t k=1; k<a->seq.v.n; ++k) {
+				if (a->seq.v.v[k]->hdr.t == VSEQ || a->seq.v.v[k]->hdr.t == VLST) {
+					j->why = "`rem: with sequences";
+				}
+			}
+			continue;
+		}
+		Jitem r;
+		if (!jc_seq(j, a, i, &r)) {
+			if (j->why == NULL) {
+				j->why = "line";
+			}
+			break;
+		}
+		if (ishead_v(a, op_if)) {
+			continue;	/* 'it set */
+		}
+		if (r.sym != NULL) {
+			j->why = "symbol as value";
+			break;
+		}
+		JM(j, RAX, r.slot, 0x48, 0x8B);	/* mov rax, [r] */
+		JM(j, RAX, ITSLOT(j), 0x48, 0x89);	/* mov [it], rax */
+		j->ty[ITSLOT(j)] = r.t;
+	}
+	if (j->why != NULL) {
+		return false;
+	}
+	/* end: 'it is the result */
+	if (live) {
+		jc_skipto(j, b.n);
+	}
+	if (!j->hasskip[b.n] || j->skip[b.n][ITSLOT(j)] != j->ret) {
+		j->why = "result type";
+		return false;
+	}
+	jc_land(j, b.n);
+	JM(j, RAX, ITSLOT(j), 0x48, 0x8B);	/* mov rax, [it] */
+	JB(j, 0x49, 0x89, 0x04, 0x24);	/* mov [r12], rax */
+	JB(j, 0x31, 0xC0);	/* xor eax, eax */
+	size_t out = j->n;
+	jc_land(j, JOUT);
+	JM(j, RDX, j->ctl, 0x48, 0x8B);	/* mov rdx, [ctl] */
+	JB(j, 0x48, 0xFF, 0x42, 16);	/* inc qword [rdx+16]: the call is over */
+	JB(j, 0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5C, 0x5B, 0x5D, 0xC3);	/* lea rsp, [rbp-16]; pop r12; pop rbx; pop rbp; ret */
+	jc_land(j, JBAIL);
+	JB(j, 0xB8, 1, 0, 0, 0);	/* mov eax, 1 */
+	JB(j, 0xE9); jc_32(j, (int32_t)out - (int32_t)(j->n + 4));	/* jmp out */
+	jc_land(j, JDEEP);
+	JB(j, 0xB8, 2, 0, 0, 0);	/* mov eax, 2 */
+	JB(j, 0xE9); jc_32(j, (int32_t)out - (int32_t)(j->n + 4));	/* jmp out */
+	jc_land(j, JLIMIT);
+	JB(j, 0xB8, 3, 0, 0, 0);	/* mov eax, 3 */
+	JB(j, 0xE9); jc_32(j, (int32_t)out - (int32_t)(j->n + 4));	/* jmp out */
+	jc_land(j, JCALLS);
+	JB(j, 0xB8, 4, 0, 0, 0);	/* mov eax, 4 */
+	JB(j, 0xE9); jc_32(j, (int32_t)out - (int32_t)(j->n + 4));	/* jmp out */
+	int32_t fs = (8 * j->nslot + 15) & ~15;
+	memcpy(j->b + frame, &fs, 4);
+	return true;
+}
+
+static Jitfn *
+jit_compile(Val *f, unsigned sig) {
+	/* f's code for argument types sig, fn NULL if not compilable */
+	Jitfn *a = calloc(1, sizeof(*a));
+	assert(a != NULL);
+	a->sig = sig;
+	const char *why = NULL;
+	size_t line = 0;
+	jtype rets[2] = {TNAT, TREA};
+	for (size_t k=0; k<2 && a->fn == NULL; ++k) {
+		size_t nl = f->symf.body.n + 1;
+		Jc j = {f, sig, rets[k]};
+		j.skip = calloc(nl, sizeof(*j.skip));
+		j.hasskip = calloc(nl, sizeof(*j.hasskip));
+		assert(j.skip != NULL && j.hasskip != NULL);
+		if (jc_body(&j)) {
+			size_t len = (j.n + 4095) & ~(size_t)4095;
+			void *m = mmap(NULL, len, PROT_READ | PROT_WRITE, 
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (m != MAP_FAILED) {
+				memcpy(m, j.b, j.n);
+				if (mprotect(m, len, PROT_READ | PROT_EXEC) == 0) {
+					a->map = m;
+					a->len = len;
+					a->fn = (int (*)(int64_t *, int64_t *, Jctl *))m;
+					a->ret = rets[k] == TNAT ? VNAT : VREA;
+				} else {
+					munmap(m, len);
+				}
+			}
+			if (a->fn == NULL) {
+				why = strerror(errno);
+			}
+		} else if (why == NULL || strcmp(j.why, "result type") != 0) {
+			why = j.why;
+			line = j.line;
+		}
+		free(j.b);
+		free(j.name);
+		free(j.slotof);
+		free(j.pa);
+		free(j.skip);
+		free(j.hasskip);
+	}
+	if (Dbg && a->fn != NULL) { 
+		outf("# jit: `%s (sig %x) compiled\n", f->symf.name, sig);
+	} else if (Dbg) {
+		outf("# jit: `%s (sig %x) not compiled: %s, line %lu\n", 
+				f->symf.name, sig, why, line);
+	}
+	return a;
+}
+
+static pthread_mutex_t Jitmx = PTHREAD_MUTEX_INITIALIZER;
+static __thread uintptr_t Jitdeep;	/* no compiled code below this frame */
+
+static bool
+jit_call(Env *e, Val *f, Val **args, Val **r) {
+	/* f applied to its argument values, in compiled code; 
+	 * false if not (yet) compiled, or if the code gave up */
+	uintptr_t fa = (uintptr_t)__builtin_frame_address(0);
+	if (fa < Jitdeep) {
+		/* the code ran out of stack above, its calls are interpreted */
+		return false;
+	}
+	Jitdeep = 0;
+	Code *c = f->symf.code;
+	size_t np = f->symf.param.n;
+	if (c == NULL || np > JITARGS || Lim->fuel > 0) {
+		/* fuel counts the interpreter's steps, which the code does not take */
+		return false;
+	}
+	unsigned sig = 0;
+	int64_t x[JITARGS];
+	for (size_t i=0; i<np; ++i) {
+		Val *a = args[i];
+		if (a->hdr.t == VNAT) {
+			memcpy(x+i, &a->nat.v, 8);
+		} else if (a->hdr.t == VREA) {
+			memcpy(x+i, &a->rea.v, 8);
+			sig |= 1u << i;
+		} else {
+			return false;
+		}
+	}
+	Jitfn *j = __atomic_load_n(&c->jit, __ATOMIC_ACQUIRE);
+	while (j != NULL && j->sig != sig) {
+		j = j->next;
+	}
+	if (j == NULL) {
+		if (__atomic_add_fetch(&c->calls, 1, __ATOMIC_RELAXED) < JITHOT) {
+			return false;
+		}
+		pthread_mutex_lock(&Jitmx);
+		for (j = c->jit; j != NULL && j->sig != sig; j = j->next) {
+		}
+		if (j == NULL) {
+			j = jit_compile(f, sig);
+			j->next = c->jit;
+			__atomic_store_n(&c->jit, j, __ATOMIC_RELEASE);
+		}
+		pthread_mutex_unlock(&Jitmx);
+	}
+	if (j->fn == NULL) {
+		return false;
+	}
+	/* its own name, called by the code, must still be f */
+	Val *g = lookup(e, f->symf.name, true, true);
+	if (g == NULL || g->hdr.t != VFUN || g->symf.code != c) {
+		return false;
+	}
+	int64_t y;
+	Jctl ctl = {fa - JITSTACK, TIMESTEPS, (int64_t)Lim->maxdepth - (int64_t)Depth};
+	int rc = j->fn(x, &y, &ctl);
+	if (rc != 0) {
+		if (rc == 2) {
+			Jitdeep = fa;
 		}
+		if (rc == 4) {
+			stop_for(LDEPTH);
+		}
+		/* past a limit, the interpreted call fails at its first step */
+		if (Dbg) { outf("# jit: `%s gave up%s\n", f->symf.name, 
+				rc == 2 ? ", too deep" : rc >= 3 ? ", past a limit" : ""); }
+		return false;
+	}
+	*r = malloc(sizeof(**r));
+	assert(*r != NULL);
+	(*r)->hdr.t = j->ret;
+	(*r)->hdr.lent = false;
+	memcpy(j->ret == VNAT ? (void *)&(*r)->nat.v : (void *)&(*r)->rea.v, &y, 8);
+	return true;
+}
+
+#else
+
+static bool
+jit_call(Env *e, Val *f, Val **args, Val **r) {
+	return false;
+}
+
+#endif
+
+/* ------------ Phrase, a line, a list of expressions --------- */
+
+typedef struct {
+	size_t n;
+	char **x;
+} Phrase;
+
+static Phrase *
+phrase() {
+	Phrase *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->n = 0;
+	a->x = NULL;
+	return a;
+}
+
+static void
+free_ph(Phrase *a) {
+	assert(a != NULL);
+	for (size_t i=0; i<a->n; ++i) {
+		free(a->x[i]);
 	}
-	/* default: add to body instead */
-	rc = eval_fun_body(e, a, 0);
-	if (rc.code == OK) {
-		/* distinguish from OK above in end 'fun :*/
-		rc.code = DEF;
+	free(a->x);
+	free(a);
+}
+
+static void
+print_ph(Phrase *a) {
+	assert(a != NULL);
+	for (size_t i=0; i<a->n; ++i) {
+		outf("%s ; ", a->x[i]);
 	}
-	return rc;
+	outf("\n");
 }
 
-static Ires
-eval_maybe_loop(Env *e, Val *a) {
-	/* returns a val, if new, freed 'a */
-	if (Dbg) { printf("#\t  %s entry: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	/* resolve symbols (not 'it) to operators and functions */
-	Ires rc = solve_lst(e, a, false, false);
-	if (rc.code != OK) {
-		rc.code = FAIL;
-		return rc;
+static Phrase *
+push_ph(Phrase *A, char *b) {
+	assert(b != NULL);
+	if (A == NULL) {
+		A = phrase();
 	}
-	if (Dbg) { printf("#\t  %s resolved: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	Val *lnst = lookup(e, LOOPNEST, false, false);
-	if (lnst == NULL) {
-		printf("? %s: nested loop count missing\n", __FUNCTION__);
-		return (Ires) {FAIL, a};
+	char **c = malloc((A->n +1)*sizeof(c));
+	if (A->n > 0) {
+		memmove(c, A->x, A->n * sizeof(char*));
 	}
-	if (lnst->hdr.t != VNAT) {
-		printf("? %s: nested loop count invalid\n", __FUNCTION__);
-		return (Ires) {FAIL, a};
+	c[A->n] = b;
+	if (A->n > 0) {
+		free(A->x);
 	}
-	/* rem: handle nested loop, another `loop val */
-	if (a->seq.v.v[0]->hdr.t == VOPE 
-			&& a->seq.v.v[0]->symop.v == op_loop) {
-		++(lnst->nat.v);
-	} /* rem: `end `loop ? */
-	else if (a->seq.v.v[0]->hdr.t == VOPE 
-			&& a->seq.v.v[0]->symop.v == op_end
-			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
-			&& a->seq.v.v[1]->hdr.t == VOPE 
-			&& a->seq.v.v[1]->symop.v == op_loop) {
-		/* `end `loop while in topmost loop, execute this */
-		if (lnst->nat.v == 0) {
-			Ires rc = eval_run(e, a, false, false);
-			return rc;
+	++(A->n);
+	A->x = c;
+	return A;
+}
+
+/* expression is 64 words large */
+#define XSZ 64*WSZ
+
+static Phrase *
+phrase_of_str(char *a) {
+	size_t boff = 0;
+	char buf[XSZ];
+	buf[0] = '\0';
+	size_t read;
+	Phrase *b = NULL;
+	char *x = NULL;
+	bool inspace = false;
+	for (size_t off = 0; a[off] != '\0'; off += read) {
+		read = grapheme_next_character_break_utf8(
+				a+off, SIZE_MAX);
+		if (strncmp(";", a+off, read) == 0) {
+			if (boff) {
+				x = malloc(1 + boff*sizeof(*x));
+				strncpy(x, buf, 1+boff);
+				b = push_ph(b, x);
+				boff = 0;
+			}
+			inspace = false;
+			continue;
+		} 
+		if (boff+read >= XSZ) {
+			outf("\n? %s: expression too big (%luB)!\n", 
+					__FUNCTION__,
+					boff+read);
+			free_ph(b);
+			return NULL;
 		}
-		--(lnst->nat.v);
-		/* then proceed to add to body */
+		if (isspace((int)*(a+off))) {
+			if (inspace) { /* remove repeated space */
+				continue;
+			}
+			if (boff == 0) { /* left trim */
+				continue;
+			}
+			inspace = true;
+		} else {
+			inspace = false;
+		}
+		/* default case: add character to current word */
+		memmove(buf+boff, a+off, read*sizeof(char));
+		boff += read;
+		buf[boff] = '\0';
 	}
-	rc = eval_loop_body(e, a, 0);
-	if (rc.code == OK) {
-		/* distinguish from eval_run above: */
-		rc.code = LOOP;
+	if (boff) {
+		x = malloc(1 + boff*sizeof(*x));
+		strncpy(x, buf, 1+boff);
+		b = push_ph(b, x);
 	}
-	return rc;
+	return b;
 }
-static Ires
-eval_maybe_skip(Env *e, Val *a) {
-	/* returns a val, if new, freed 'a */
-	if (Dbg) { printf("#\t  %s entry: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	Ires rc = solve_lst(e, a, false, true);
-	if (rc.code != OK) {
-		rc.code = FAIL;
-		return rc;
+
+/* -------------- Phrase -------------- */
+
+/* values of recently parsed expressions, by text: 
+ * parsing does not depend on the env, a repeated expression 
+ * is copied from here instead of going through the front end again */
+#define PCSZ 512
+
+typedef struct {
+	uint64_t h;
+	char *x;	/* NULL if unused */
+	Val *v;
+} Pcache;
+
+static __thread Pcache *Pc;	/* per thread, as contexts run in parallel */
+static pthread_key_t Pckey;	/* frees a thread's cache when it ends */
+static pthread_once_t Pconce = PTHREAD_ONCE_INIT;
+
+static void
+free_pc(void *a) {
+	/* a thread's cache, as the thread ends */
+	Pcache *c = a;
+	for (size_t i=0; i<PCSZ; ++i) {
+		if (c[i].x != NULL) {
+			free(c[i].x);
+			free_v(c[i].v);
+		}
 	}
-	if (Dbg) { printf("#\t  %s resolved: ", __FUNCTION__); printx_v(a,false,"#\t"); printf("\n"); }
-	bool an_endif = a->seq.v.v[0]->hdr.t == VOPE 
-			&& a->seq.v.v[0]->symop.v == op_end
-			&& a->seq.v.v[0]->symop.arity == a->seq.v.n -1
-			&& a->seq.v.v[1]->hdr.t == VOPE 
-			&& a->seq.v.v[1]->symop.v == op_if ;
-	bool an_else = a->seq.v.v[0]->hdr.t == VOPE 
-			&& a->seq.v.v[0]->symop.v == op_else ;
-	if (an_endif || an_else) {
-		Ires rc = eval_run(e, a, false, false);
-		return rc;
+	free(c);
+}
+static void
+pc_key(void) {
+	pthread_key_create(&Pckey, free_pc);
+}
+static Pcache *
+pc_of(void) {
+	/* this thread's cache, made on first use */
+	if (Pc == NULL) {
+		pthread_once(&Pconce, pc_key);
+		Pc = calloc(PCSZ, sizeof(*Pc));
+		assert(Pc != NULL);
+		pthread_setspecific(Pckey, Pc);
+	}
+	return Pc;
+}
+
+static Val *
+parse_x(Env *env, char *x) {
+	/* fresh value of expression x, or NULL */
+	uint64_t h = hash_str(x);
+	Pcache *c = pc_of() + h % PCSZ;
+	if (c->x != NULL && c->h == h && strcmp(c->x, x) == 0) {
+		if (Dbg) { outf("# parse cache hit: %s\n", x); }
+		return copy_v(c->v);
+	}
+	Expr *ex = exp_of_words(x);
+	if (ex == NULL) {
+		return NULL;
 	}
-	/* default: skip */
-	Val *it = lookup(e, ITNAME, false, false);
-	if (it == NULL) {
-		printf("? %s: 'it undefined\n", __FUNCTION__);
-		return (Ires) {FAIL, a};
+	Sem *sm = seme_of_exp(ex);
+	free_x(ex);
+	if (sm == NULL) {
+		return NULL;
 	}
-	free_v(a);
-	return (Ires) {NOP, copy_v(it)};
+	Val *v = val_of_seme(env, sm);
+	free_s(sm);
+	free(sm);
+	if (v == NULL) {
+		return NULL;
+	}
+	if (c->x != NULL) {
+		free(c->x);
+		free_v(c->v);
+	}
+	c->h = h;
+	c->x = strdup(x);
+	assert(c->x != NULL);
+	c->v = copy_v(v);
+	return v;
 }
 
-static bool  
-transition(Env *e, Val *a) {
-	/* a's execution updates env 'e.
-	 * frees 'a, updates env's state, sets 'it, returns success indicator
-	 */
-	assert(e != NULL && "env is null");
-	assert(a != NULL && "value is null");
-	if (Dbg) { printf("#\t %s: entry\n", __FUNCTION__); print_env(e, "#\t"); }
-	/* do something (with a) */
-	Ires rc;
-	switch (e->state) {
-		/* following eval_*() must keep only one val alloc'd */
-		case RUN:
-			rc = eval_run(e, a, false, true);
+static bool
+eval_ph(Env *env, Phrase *a, List_v *rec) {
+	/* evaluate by line, for later line-specific behaviour, 
+	 * keeping a copy of each value in rec if not NULL */
+	assert(env != NULL && "environment null");
+	assert(a != NULL && "phrase null");
+	for (size_t i=0; i<a->n; ++i) {
+		Val *v = parse_x(env, a->x[i]);
+		if (v == NULL) {
+			return false;
+		}
+		if (rec != NULL) {
+			*rec = push_l(*rec, copy_v(v));
+		}
+		bool t = transition(env, v);
+		if (!t) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* ----- binary images of values: script cache ----- 
+ * Values are written depth first, a tag byte then the contents, 
+ * numbers in host order: an image is read back on the same kind of host.
+ */
+
+#define IMGMAGIC "CSPK"
+#define IMGVERSION 1
+
+typedef struct {
+	char *b;
+	size_t n;
+	size_t cap;
+} Wbuf;
+
+typedef struct {
+	const char *b;
+	size_t n;
+	size_t at;
+	bool err;
+} Rbuf;
+
+static void
+put_b(Wbuf *w, const void *a, size_t n) {
+	if (w->n + n > w->cap) {
+		w->cap = 2 * (w->n + n);
+		w->b = realloc(w->b, w->cap);
+		assert(w->b != NULL);
+	}
+	memcpy(w->b + w->n, a, n);
+	w->n += n;
+}
+static void
+put_u64(Wbuf *w, uint64_t a) {
+	put_b(w, &a, sizeof(a));
+}
+static void
+put_str(Wbuf *w, const char *a) {
+	uint64_t n = strlen(a);
+	put_u64(w, n);
+	put_b(w, a, n);
+}
+static void
+put_v(Wbuf *w, Val *a) {
+	uint8_t t = a->hdr.t;
+	put_b(w, &t, 1);
+	switch (a->hdr.t) {
+		case VNIL:
 			break;
-		case LOOPDEF:
-			rc = eval_maybe_loop(e, a);
-			/* if ended a loop definition, execute it now */
-			if (rc.code == OK) {
-				rc = eval_loop(e, rc.v);
-			}
+		case VNAT:
+			put_b(w, &a->nat.v, sizeof(a->nat.v));
 			break;
-		case FUNDEF:
-			rc = eval_maybe_def(e, a);
+		case VREA:
+			put_b(w, &a->rea.v, sizeof(a->rea.v));
 			break;
-		case IFSKIP:
-			rc = eval_maybe_skip(e, a);
+		case VBIG:
+			put_u64(w, a->big.v->neg);
+			put_u64(w, a->big.v->n);
+			put_b(w, a->big.v->d, a->big.v->n * sizeof(uint32_t));
 			break;
-		default:
-			printf("? %s: invalid state\n", __FUNCTION__);
-			e->state = FATAL;
-			return false;
-	}
-	if (Dbg) { printf("#\t %s: eval ", __FUNCTION__); print_code(rc.code); printf("\n");}
-	/* transition state */
-	switch (rc.code) {
-		case FAIL:
-			e->state = FATAL;
-			free_v(rc.v);
+		case VSYM:
+			put_str(w, a->sym.v);
+			break;
+		case VOPE:
+			put_str(w, a->symop.name);
+			break;
+		case VLST:
+		case VSEQ:
+			put_u64(w, a->seq.v.n);
+			for (size_t i=0; i<a->seq.v.n; ++i) {
+				put_v(w, a->seq.v.v[i]);
+			}
 			break;
-		case NOP: /* did nothing */
+		case VARR:
+			put_u64(w, a->arr.v->t);
+			put_u64(w, a->arr.v->n);
+			put_b(w, a->arr.v->v.nat, a->arr.v->n * sizeof(long long));
 			break;
-		case OK: /* did something */
-			if (e->state == IFSKIP 
-					|| e->state == FUNDEF 
-					|| e->state == LOOPDEF) {
-				e->state = RUN;
+		case VVEC:
+			put_u64(w, vn_len(a->vec.v));
+			for (size_t i=0; i<vn_len(a->vec.v); ++i) {
+				put_v(w, vn_at(a->vec.v, i));
 			}
 			break;
-		case SKIP:
-			e->state = IFSKIP;
+		case VFUN:
+			put_str(w, a->symf.name);
+			put_u64(w, a->symf.param.n);
+			for (size_t i=0; i<a->symf.param.n; ++i) {
+				put_v(w, a->symf.param.v[i]);
+			}
+			put_u64(w, a->symf.body.n);
+			for (size_t i=0; i<a->symf.body.n; ++i) {
+				put_v(w, a->symf.body.v[i]);
+			}
+			put_u64(w, a->symf.cap != NULL ? a->symf.cap->n : 0);
+			for (size_t i=0; a->symf.cap != NULL && i<a->symf.cap->n; ++i) {
+				put_str(w, a->symf.cap->s[i]->name);
+				put_v(w, a->symf.cap->s[i]->v);
+			}
 			break;
-		case DEF:
-			e->state = FUNDEF;
+		case VGEN:
+			put_u64(w, a->gen.v->from);
+			put_u64(w, a->gen.v->n);
+			put_u64(w, a->gen.v->f != NULL);
+			if (a->gen.v->f != NULL) {
+				put_v(w, a->gen.v->f);
+			}
 			break;
-		case RET:
-			e->state = RETURN;
+	}
+}
+
+static const void *
+get_b(Rbuf *r, size_t n) {
+	if (r->err || r->n - r->at < n) {
+		r->err = true;
+		return NULL;
+	}
+	const void *a = r->b + r->at;
+	r->at += n;
+	return a;
+}
+static uint64_t
+get_u64(Rbuf *r) {
+	uint64_t a = 0;
+	const void *b = get_b(r, sizeof(a));
+	if (b != NULL) {
+		memcpy(&a, b, sizeof(a));
+	}
+	return a;
+}
+static bool
+get_str(Rbuf *r, char *a) {
+	/* into a[WSZ] */
+	uint64_t n = get_u64(r);
+	if (n >= WSZ) {
+		r->err = true;
+		return false;
+	}
+	const char *b = get_b(r, n);
+	if (b == NULL) {
+		return false;
+	}
+	memcpy(a, b, n);
+	a[n] = '\0';
+	return true;
+}
+static uint64_t
+get_n(Rbuf *r, size_t sz) {
+	/* an element count, checked against what is left to read */
+	uint64_t n = get_u64(r);
+	if (r->err || (sz > 0 && n > (r->n - r->at) / sz)) {
+		r->err = true;
+		return 0;
+	}
+	return n;
+}
+static Val *
+get_v(Rbuf *r) {
+	/* fresh value, or NULL with r->err set */
+	const uint8_t *t = get_b(r, 1);
+	if (t == NULL) {
+		return NULL;
+	}
+	Val *a = malloc(sizeof(*a));
+	assert(a != NULL);
+	a->hdr.t = *t;
+	a->hdr.lent = false;
+	const void *b;
+	uint64_t n;
+	switch (a->hdr.t) {
+		case VNIL:
+			return a;
+		case VNAT:
+			if ((b = get_b(r, sizeof(a->nat.v))) != NULL) {
+				memcpy(&a->nat.v, b, sizeof(a->nat.v));
+				return a;
+			}
 			break;
-		case LOOP:
-			e->state = LOOPDEF;
+		case VREA:
+			if ((b = get_b(r, sizeof(a->rea.v))) != NULL) {
+				memcpy(&a->rea.v, b, sizeof(a->rea.v));
+				return a;
+			}
 			break;
-		case INT:
-			e->state = STOP;
+		case VBIG: {
+			bool neg = get_u64(r) != 0;
+			n = get_n(r, sizeof(uint32_t));
+			if (r->err || n == 0) {
+				break;
+			}
+			uint32_t *d = malloc(n * sizeof(*d));
+			assert(d != NULL);
+			memcpy(d, get_b(r, n * sizeof(*d)), n * sizeof(*d));
+			free(a);
+			return val_of_mag(neg, d, n);
+		}
+		case VSYM:
+			a->sym.site = 0;
+			if (get_str(r, a->sym.v)) {
+				return a;
+			}
 			break;
+		case VOPE: {
+			char name[WSZ];
+			const Symop *so = get_str(r, name) ? lookup_op(name) : NULL;
+			if (so == NULL) {
+				r->err = true;
+				break;
+			}
+			a->symop.prio = so->prio;
+			a->symop.v = so->f;
+			a->symop.arity = so->arity;
+			a->symop.site = 0;
+			strncpy(a->symop.name, so->name, sizeof(a->symop.name));
+			return a;
+		}
+		case VLST:
+		case VSEQ:
+			a->lst.h = 0;
+			a->seq.v.n = 0;
+			a->seq.v.v = NULL;
+			n = get_n(r, 1);
+			if (n > 0) {
+				a->seq.v.v = malloc(n * sizeof(Val *));
+				assert(a->seq.v.v != NULL);
+			}
+			for (size_t i=0; i<n; ++i) {
+				Val *c = get_v(r);
+				if (c == NULL) {
+					free_v(a);
+					return NULL;
+				}
+				a->seq.v.v[a->seq.v.n++] = c;
+			}
+			return a;
+		case VARR: {
+			vtype at = get_u64(r);
+			n = get_n(r, sizeof(long long));
+			if (r->err || (at != VNAT && at != VREA)) {
+				r->err = true;
+				break;
+			}
+			free(a);
+			a = arr_v(at, n);
+			if (n > 0) {
+				memcpy(a->arr.v->v.nat, get_b(r, n * sizeof(long long)), 
+						n * sizeof(long long));
+			}
+			return a;
+		}
+		case VVEC: {
+			n = get_n(r, 1);
+			Val **v = malloc((n > 0 ? n : 1) * sizeof(*v));
+			assert(v != NULL);
+			for (size_t i=0; i<n; ++i) {
+				v[i] = get_v(r);
+				if (v[i] == NULL) {
+					for (size_t j=0; j<i; ++j) {
+						free_v(v[j]);
+					}
+					free(v);
+					free(a);
+					return NULL;
+				}
+			}
+			a->vec.v = vn_build(v, n);
+			free(v);
+			return a;
+		}
+		case VFUN: {
+			a->symf.param.n = a->symf.body.n = 0;
+			a->symf.param.v = a->symf.body.v = NULL;
+			a->symf.cap = NULL;
+			a->symf.code = NULL;
+			if (!get_str(r, a->symf.name)) {
+				break;
+			}
+			List_v *l[2] = {&a->symf.param, &a->symf.body};
+			for (size_t k=0; k<2; ++k) {
+				n = get_n(r, 1);
+				for (size_t i=0; i<n; ++i) {
+					Val *c = get_v(r);
+					if (c == NULL) {
+						free_v(a);
+						return NULL;
+					}
+					*l[k] = push_l(*l[k], c);
+				}
+			}
+			n = get_n(r, 1);
+			if (n > 0 && !r->err) {
+				Frame *f = malloc(sizeof(*f));
+				assert(f != NULL);
+				f->refs = 1;
+				f->n = 0;
+				f->s = malloc(n * sizeof(*f->s));
+				assert(f->s != NULL);
+				a->symf.cap = f;
+				for (size_t i=0; i<n; ++i) {
+					char name[WSZ];
+					Val *c = get_str(r, name) ? get_v(r) : NULL;
+					if (c == NULL) {
+						r->err = true;
+						free_v(a);
+						return NULL;
+					}
+					f->s[f->n++] = symval(name, c);
+					free_v(c);
+				}
+			}
+			if (r->err) {
+				free_v(a);
+				return NULL;
+			}
+			a->symf.code = code_of(a->symf.body);
+			return a;
+		}
+		case VGEN: {
+			long long from = get_u64(r);
+			n = get_u64(r);
+			Val *f = NULL;
+			if (get_u64(r) != 0) {
+				f = get_v(r);
+				if (f == NULL) {
+					break;
+				}
+				if (f->hdr.t != VFUN && f->hdr.t != VOPE) {
+					free_v(f);
+					break;
+				}
+			}
+			if (r->err) {
+				free_v(f);
+				break;
+			}
+			free(a);
+			return gen_v(from, n, f);
+		}
 		default:
-			/* BACK is invalid for example */
-			printf("? %s: invalid evaluation code\n", __FUNCTION__);
-			e->state = FATAL;
-			free_v(rc.v);
+			break;
 	}
-	/* react to transition */
-	if (e->state == FATAL) {
+	r->err = true;
+	free(a);
+	return NULL;
+}
+
+static uint64_t
+hash_bytes(uint64_t h, const void *a, size_t n) {
+	/* FNV-1a */
+	const unsigned char *b = a;
+	for (size_t i=0; i<n; ++i) {
+		h ^= b[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+#define HASHSEED 0xcbf29ce484222325ULL
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint64_t src;	/* hash of what the image was made from */
+	uint64_t sum;	/* hash of the payload */
+	uint64_t n;	/* payload size */
+} Imghdr;
+
+static bool
+write_image(const char *path, uint64_t src, Wbuf *w) {
+	/* header then w's payload, written aside then renamed in place */
+	Imghdr h;
+	memcpy(h.magic, IMGMAGIC, sizeof(h.magic));
+	h.version = IMGVERSION;
+	h.src = src;
+	h.sum = hash_bytes(HASHSEED, w->b, w->n);
+	h.n = w->n;
+	char tmp[PATH_MAX];
+	if (snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid()) >= (int)sizeof(tmp)) {
+		outf("? %s: path too long\n", __FUNCTION__);
 		return false;
 	}
-	/* update env, with 'it */
-	Symval *it = symval(ITNAME, rc.v);
-	free_v(rc.v);
-	if (it == NULL) {
-		e->state = FATAL;
+	FILE *f = fopen(tmp, "wb");
+	if (f == NULL) {
+		outf("? %s: %s: %s\n", __FUNCTION__, tmp, strerror(errno));
 		return false;
 	}
-	if (!stored_sym(e, it)) {
-		free_symval(it);
-		e->state = FATAL;
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1 
+		&& (w->n == 0 || fwrite(w->b, w->n, 1, f) == 1);
+	ok = (fclose(f) == 0) && ok;
+	if (!ok || rename(tmp, path) != 0) {
+		outf("? %s: %s: %s\n", __FUNCTION__, path, strerror(errno));
+		remove(tmp);
 		return false;
 	}
-	if (Dbg) { printf("#\t %s: exit\n", __FUNCTION__); print_env(e, "#\t"); }
 	return true;
 }
 
-/* ------------ Phrase, a line, a list of expressions --------- */
-
 typedef struct {
-	size_t n;
-	char **x;
-} Phrase;
-
-static Phrase *
-phrase() {
-	Phrase *a = malloc(sizeof(*a));
-	assert(a != NULL);
-	a->n = 0;
-	a->x = NULL;
-	return a;
-}
+	void *map;
+	size_t len;
+	Rbuf r;
+} Image;
 
-static void
-free_ph(Phrase *a) {
-	assert(a != NULL);
-	for (size_t i=0; i<a->n; ++i) {
-		free(a->x[i]);
+static bool
+map_image(const char *path, uint64_t src, Image *im) {
+	/* maps path, checks its header and source hash, 
+	 * im->r reads the payload; false if missing or stale */
+	im->map = NULL;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
 	}
-	free(a->x);
-	free(a);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Imghdr)) {
+		close(fd);
+		return false;
+	}
+	im->len = st.st_size;
+	im->map = mmap(NULL, im->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (im->map == MAP_FAILED) {
+		im->map = NULL;
+		return false;
+	}
+	Imghdr h;
+	memcpy(&h, im->map, sizeof(h));
+	const char *pl = (const char *)im->map + sizeof(h);
+	if (memcmp(h.magic, IMGMAGIC, sizeof(h.magic)) != 0 
+			|| h.version != IMGVERSION
+			|| h.src != src
+			|| h.n != im->len - sizeof(h)
+			|| h.sum != hash_bytes(HASHSEED, pl, h.n)) {
+		munmap(im->map, im->len);
+		im->map = NULL;
+		return false;
+	}
+	im->r = (Rbuf) {pl, h.n, 0, false};
+	return true;
 }
-
 static void
-print_ph(Phrase *a) {
-	assert(a != NULL);
-	for (size_t i=0; i<a->n; ++i) {
-		printf("%s ; ", a->x[i]);
+unmap_image(Image *im) {
+	if (im->map != NULL) {
+		munmap(im->map, im->len);
+		im->map = NULL;
 	}
-	printf("\n");
 }
 
-static Phrase *
-push_ph(Phrase *A, char *b) {
-	assert(b != NULL);
-	if (A == NULL) {
-		A = phrase();
+/* environment images hold the symbols of a root env, 
+ * a name then a value each, functions with what they captured */
+#define IMGENV hash_bytes(HASHSEED, "env", 3)
+
+static long long
+save_image(Env *e, char *path) {
+	/* symbols saved, or -1 */
+	while (e->parent != NULL) {
+		e = e->parent;
+	}
+	Wbuf w = {NULL, 0, 0};
+	put_u64(&w, e->n);
+	for (size_t i=0; i<e->n; ++i) {
+		put_str(&w, e->s[i]->name);
+		put_v(&w, e->s[i]->v);
+	}
+	bool ok = write_image(path, IMGENV, &w);
+	free(w.b);
+	return ok ? (long long)e->n : -1;
+}
+static bool
+load_image(Env *e, const char *path) {
+	/* stores the symbols of the image at path in e */
+	Image im;
+	if (!map_image(path, IMGENV, &im)) {
+		outf("? %s: %s: no valid image\n", __FUNCTION__, path);
+		return false;
 	}
-	char **c = malloc((A->n +1)*sizeof(c));
-	if (A->n > 0) {
-		memmove(c, A->x, A->n * sizeof(char*));
+	uint64_t n = get_n(&im.r, 1);
+	for (size_t i=0; i<n; ++i) {
+		char name[WSZ];
+		Val *a = get_str(&im.r, name) ? get_v(&im.r) : NULL;
+		if (a == NULL) {
+			break;
+		}
+		Symval *sv = symval(name, a);
+		free_v(a);
+		if (sv == NULL || !stored_sym(e, sv)) {
+			if (sv != NULL) {
+				free_symval(sv);
+			}
+			im.r.err = true;
+			break;
+		}
 	}
-	c[A->n] = b;
-	if (A->n > 0) {
-		free(A->x);
+	bool ok = !im.r.err && im.r.at == im.r.n;
+	unmap_image(&im);
+	if (!ok) {
+		outf("? %s: %s: corrupt image\n", __FUNCTION__, path);
 	}
-	++(A->n);
-	A->x = c;
-	return A;
+	return ok;
 }
 
-/* expression is 64 words large */
-#define XSZ 64*WSZ
+/* ------------ library: contexts, see codespeak.h --------- */
 
-static Phrase *
-phrase_of_str(char *a) {
-	size_t boff = 0;
-	char buf[XSZ];
-	buf[0] = '\0';
-	size_t read;
-	Phrase *b = NULL;
-	char *x = NULL;
-	bool inspace = false;
-	for (size_t off = 0; a[off] != '\0'; off += read) {
-		read = grapheme_next_character_break_utf8(
-				a+off, SIZE_MAX);
-		if (strncmp(";", a+off, read) == 0) {
-			if (boff) {
-				x = malloc(1 + boff*sizeof(*x));
-				strncpy(x, buf, 1+boff);
-				b = push_ph(b, x);
-				boff = 0;
-			}
-			inspace = false;
+struct Cs_ {
+	Env *e;	/* root */
+	bool dbg;
+	bool jit;
+	bool opt;
+	Limits lim;
+	void (*out)(void *arg, const char *s, size_t n);
+	void *arg;
+};
+
+Cs *
+cs_new(void) {
+	Cs *c = calloc(1, sizeof(*c));
+	if (c == NULL) {
+		return NULL;
+	}
+	c->e = new_env(NULL);
+	if (c->e == NULL) {
+		free(c);
+		return NULL;
+	}
+	limits_init(&c->lim);
+	return c;
+}
+void
+cs_free(Cs *c) {
+	if (c == NULL) {
+		return;
+	}
+	free_env(c->e, true);
+	free(c);
+}
+bool
+cs_image(Cs *c, const char *path) {
+	return load_image(c->e, path);
+}
+void
+cs_debug(Cs *c, bool on) {
+	c->dbg = on;
+}
+void
+cs_jit(Cs *c, bool on) {
+	c->jit = on;
+}
+void
+cs_opt(Cs *c, bool on) {
+	c->opt = on;
+}
+void
+cs_limits(Cs *c, size_t fuel, long ms, size_t depth) {
+	c->lim.fuel = fuel;
+	c->lim.timeout = ms;
+	c->lim.maxdepth = depth > 0 ? depth : MAXDEPTH;
+}
+void
+cs_output(Cs *c, void (*out)(void *arg, const char *s, size_t n), void *arg) {
+	c->out = out;
+	c->arg = arg;
+}
+cs_rc
+cs_eval(Cs *c, const char *text) {
+	/* as main reads its lines, but a failed line leaves c in RUN state */
+	char *buf = NULL;
+	size_t bufn = 0;
+	FILE *out = Outf;
+	if (c->out != NULL) {
+		Outf = open_memstream(&buf, &bufn);
+		if (Outf == NULL) {
+			Outf = out;
+			return CS_FAIL;
+		}
+	}
+	bool dbg = Dbg;
+	bool jit = Jit;
+	bool opt = Opt;
+	Limits *lim = Lim;
+	Dbg = c->dbg;
+	Jit = c->jit;
+	Opt = c->opt;
+	Lim = &c->lim;
+	cs_rc r = CS_OK;
+	const char *a = text;
+	while (r == CS_OK && *a != '\0') {
+		size_t n = strcspn(a, "\n");
+		char *line = strndup(a, n);
+		assert(line != NULL);
+		a += a[n] == '\n' ? n+1 : n;
+		if (n > 0 && isspace((int)line[n-1])) {
+			line[n-1] = '\0';
+		}
+		if (strlen(line) == 0) {
+			free(line);
 			continue;
-		} 
-		if (boff+read >= XSZ) {
-			printf("\n? %s: expression too big (%luB)!\n", 
-					__FUNCTION__,
-					boff+read);
-			free_ph(b);
-			return NULL;
 		}
-		if (isspace((int)*(a+off))) {
-			if (inspace) { /* remove repeated space */
-				continue;
-			}
-			if (boff == 0) { /* left trim */
-				continue;
-			}
-			inspace = true;
-		} else {
-			inspace = false;
+		Phrase *ph = phrase_of_str(line);
+		free(line);
+		if (ph == NULL) {
+			r = CS_FAIL;
+			break;
+		}
+		if (Dbg) { outf("# phrase: "); print_ph(ph); }
+		phrase_begin();
+		bool ok = eval_ph(c->e, ph, NULL);
+		free_ph(ph);
+		if (!phrase_end()) {
+			r = CS_LIMIT;
+		} else if (!ok) {
+			r = CS_FAIL;
+		}
+		if (r != CS_OK) {
+			c->e->state = RUN;
+		}
+	}
+	if (c->out != NULL) {
+		fclose(Outf);
+		if (bufn > 0) {
+			c->out(c->arg, buf, bufn);
+		}
+		free(buf);
+	}
+	Outf = out;
+	Dbg = dbg;
+	Jit = jit;
+	Opt = opt;
+	Lim = lim;
+	return r;
+}
+static Val *
+cs_val(Cs *c, const char *name) {
+	/* value of name in c's root env, NULL if undefined */
+	char b[WSZ];
+	if (strlen(name) == 0 || strlen(name) >= WSZ) {
+		return NULL;
+	}
+	strcpy(b, strcmp(name, IT) == 0 ? ITNAME : name);
+	return lookup(c->e, b, false, true);
+}
+cs_kind
+cs_kind_of(Cs *c, const char *name) {
+	Val *a = cs_val(c, name);
+	if (a == NULL) {
+		return CS_NONE;
+	}
+	switch (a->hdr.t) {
+		case VNAT:
+			return CS_NAT;
+		case VREA:
+			return CS_REAL;
+		case VLST:
+		case VARR:
+		case VVEC:
+		case VGEN:
+			return CS_LIST;
+		default:
+			return CS_OTHER;
+	}
+}
+bool
+cs_nat(Cs *c, const char *name, long long *v) {
+	Val *a = cs_val(c, name);
+	if (a == NULL || a->hdr.t != VNAT) {
+		return false;
+	}
+	*v = a->nat.v;
+	return true;
+}
+bool
+cs_real(Cs *c, const char *name, double *v) {
+	Val *a = cs_val(c, name);
+	if (a == NULL || (a->hdr.t != VNAT && a->hdr.t != VREA)) {
+		return false;
+	}
+	*v = a->hdr.t == VNAT ? (double)a->nat.v : a->rea.v;
+	return true;
+}
+size_t
+cs_reals(Cs *c, const char *name, double *v, size_t n) {
+	Val *a = cs_val(c, name);
+	if (a == NULL || (a->hdr.t != VLST && a->hdr.t != VARR && a->hdr.t != VVEC
+			&& (a->hdr.t != VGEN || a->gen.v->f != NULL))) {
+		return 0;
+	}
+	size_t len = len_v(a);
+	for (size_t i=0; i<len; ++i) {
+		Val tmp;
+		Val *b = elem_v(a, i, &tmp);
+		if (b->hdr.t != VNAT && b->hdr.t != VREA) {
+			return 0;
+		}
+		if (i < n) {
+			v[i] = b->hdr.t == VNAT ? (double)b->nat.v : b->rea.v;
 		}
-		/* default case: add character to current word */
-		memmove(buf+boff, a+off, read*sizeof(char));
-		boff += read;
-		buf[boff] = '\0';
 	}
-	if (boff) {
-		x = malloc(1 + boff*sizeof(*x));
-		strncpy(x, buf, 1+boff);
-		b = push_ph(b, x);
+	return len;
+}
+char *
+cs_text(Cs *c, const char *name) {
+	Val *a = cs_val(c, name);
+	if (a == NULL) {
+		return NULL;
 	}
-	return b;
+	char *buf = NULL;
+	size_t n = 0;
+	FILE *out = Outf;
+	Outf = open_memstream(&buf, &n);
+	if (Outf == NULL) {
+		Outf = out;
+		return NULL;
+	}
+	print_v(a, false);
+	fclose(Outf);
+	Outf = out;
+	while (n > 0 && isspace((int)buf[n-1])) {
+		buf[--n] = '\0';
+	}
+	return buf;
 }
 
-/* -------------- Phrase -------------- */
+#ifndef CODESPEAK_LIB
+
+/* ----- trace file and interrupts, of the command line ----- */
 
+static const char *Evname[] = {"trans", "state", "reduce", "call", "loop", 
+	"line", "force"};
+static const char *Lnname[] = {"value", "fused", "loop", "skip"};
+static const char *Stname[] = {"Fatal", "Ok", "Skip", "Fun", "Backtrack", 
+	"Return", "Loop", "Stop"};
+static const char *Rcname[] = {"Fail", "Ok", "Nop", "Skip", "Def", "Back", 
+	"Ret", "Loop", "Int"};
+
+static char *Tracefile = "trace.out";
+
+static void
+trace_dump(void) {
+	/* the ring, oldest first, to Tracefile */
+	FILE *f = fopen(Tracefile, "w");
+	if (f == NULL) {
+		outf("? %s: cannot write '%s\n", __FUNCTION__, Tracefile);
+		return;
+	}
+	uint64_t n = Ringat < TRSZ ? Ringat : TRSZ;
+	Trhdr h = {TRMAGIC, TRVERSION, sizeof(Trec), 0, n};
+	fwrite(&h, sizeof(h), 1, f);
+	for (uint64_t k = Ringat - n; k < Ringat; ++k) {
+		fwrite(Ring + (k & (TRSZ-1)), sizeof(Trec), 1, f);
+	}
+	fclose(f);
+}
 static bool
-eval_ph(Env *env, Phrase *a) {
-	/* evaluate by line, for later line-specific behaviour */
-	assert(env != NULL && "environment null");
-	assert(a != NULL && "phrase null");
-	for (size_t i=0; i<a->n; ++i) {
-		Expr *ex = exp_of_words(a->x[i]);
-		if (ex == NULL) {
-			return false;
-		}
-		Sem *sm = seme_of_exp(ex);
-		free_x(ex);
-		if (sm == NULL) {
-			return false;
+trace_on(char *cats) {
+	/* cats: comma separated categories, or all */
+	char *c = strtok(cats, ",");
+	for (; c != NULL; c = strtok(NULL, ",")) {
+		size_t i = 0;
+		for (; i < sizeof(Evname)/sizeof(*Evname); ++i) {
+			if (strcmp(c, Evname[i]) == 0) {
+				break;
+			}
 		}
-		Val *v = val_of_seme(env, sm);
-		free_s(sm);
-		free(sm);
-		if (v == NULL) {
+		if (strcmp(c, "all") == 0) {
+			Trace = EVTRANS | EVSTATE | EVREDUCE | EVCALL | EVLOOP | EVLINE | EVFORCE;
+		} else if (i < sizeof(Evname)/sizeof(*Evname)) {
+			Trace |= 1u << i;
+		} else {
+			outf("? %s: unknown trace category '%s\n", __FUNCTION__, c);
 			return false;
 		}
-		if (Dbg) { printf("# %3lu %6s: ", i, "value"); printx_v(v,false,"#\t"); printf("\n"); }
-		bool t = transition(env, v);
-		if (Dbg) { printf("# %3lu %6s: ", i, "eval"); print_istate(env->state); printf("\n"); }
-		if (!t) {
-			return false;
+	}
+	Ring = calloc(TRSZ, sizeof(*Ring));
+	assert(Ring != NULL);
+	Ring0 = now_ns();
+	atexit(trace_dump);
+	return true;
+}
+static const char *
+name_of(const char **names, size_t n, unsigned k) {
+	return k < n ? names[k] : "?";
+}
+static bool
+trace_decode(char *path) {
+	/* the records of trace file path, as text */
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		outf("? %s: cannot read '%s\n", __FUNCTION__, path);
+		return false;
+	}
+	Trhdr h;
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRMAGIC, 4) != 0
+			|| h.version != TRVERSION || h.size != sizeof(Trec)) {
+		outf("? %s: '%s not a trace\n", __FUNCTION__, path);
+		fclose(f);
+		return false;
+	}
+	size_t nst = sizeof(Stname)/sizeof(*Stname);
+	size_t nrc = sizeof(Rcname)/sizeof(*Rcname);
+	Trec r;
+	for (uint64_t k=0; k<h.n && fread(&r, sizeof(r), 1, f) == 1; ++k) {
+		char name[sizeof(r.s)+1];
+		memcpy(name, r.s, sizeof(r.s));
+		name[sizeof(r.s)] = '\0';
+		outf("%llu.%06llu t%u ", (unsigned long long)(r.ns / 1000000000ULL), 
+				(unsigned long long)(r.ns % 1000000000ULL / 1000), r.tid);
+		switch (r.ev) {
+			case EVTRANS:
+				outf("trans %s items %u env %llu\n", name_of(Stname, nst, r.a), 
+						r.b, (unsigned long long)r.x);
+				break;
+			case EVSTATE:
+				outf("state %s to %s (%s)\n", name_of(Stname, nst, r.a), 
+						name_of(Stname, nst, r.b), name_of(Rcname, nrc, r.x));
+				break;
+			case EVREDUCE:
+				outf("reduce `%s at %u of %llu\n", name, r.b, (unsigned long long)r.x);
+				break;
+			case EVCALL:
+				outf("call `%s (%u)%s env %llu\n", name, r.b, 
+						r.a ? " compiled" : "", (unsigned long long)r.x);
+				break;
+			case EVLOOP:
+				outf("loop %u pass %llu\n", r.a, (unsigned long long)r.x);
+				break;
+			case EVLINE:
+				outf("line `%s %u to %llu %s\n", name, r.b, (unsigned long long)r.x, 
+						name_of(Lnname, sizeof(Lnname)/sizeof(*Lnname), r.a));
+				break;
+			case EVFORCE:
+				outf("force %s x%llu\n", r.a ? "generate" : "range", (unsigned long long)r.x);
+				break;
+			default:
+				outf("? %u\n", r.ev);
 		}
 	}
+	fclose(f);
 	return true;
 }
+static void
+on_sigint(int sig) {
+	if (__atomic_load_n(&Running, __ATOMIC_RELAXED) == 0) {
+		/* nothing to interrupt: the default, end the process */
+		signal(SIGINT, SIG_DFL);
+		raise(SIGINT);
+		return;
+	}
+	__atomic_add_fetch(&Intrs, 1, __ATOMIC_RELAXED);
+}
+static void
+limits_on(void) {
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_sigint;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+}
 
 /* ----- main ----- */
 
 typedef enum {LINE, EMPTYL, ENDL, ERRL} Lrc;
 
 static Lrc 
-readline(char **S) {
+readline(FILE *in, char **S) {
 	char *line = NULL;
 	size_t linesz = 0;
 	ssize_t rd = 0;
 	errno = 0;
-	rd = getline(&line, &linesz, stdin);
+	rd = getline(&line, &linesz, in);
 	if (rd == -1) {
-		if (ferror(stdin) != 0) {
-			printf("? %s: %s\n",
+		if (ferror(in) != 0) {
+			outf("? %s: %s\n",
 					__FUNCTION__,
 					strerror(errno));
 			return ERRL;
@@ -3131,35 +8416,165 @@ readline(char **S) {
 	return LINE;
 }
 
-int
-main(int argc, char **argv) {
-	if (argc == 2) {
-		Dbg = true;
+static void
+free_lines(char **a, size_t n) {
+	for (size_t i=0; i<n; ++i) {
+		free(a[i]);
 	}
-	/* initialize root env */
-	Env *e = new_env(NULL);
+	free(a);
+}
+
+static bool
+cached_lines(Image *im, size_t n, List_v *v) {
+	/* decodes n lines of expression lists, v[n] fresh */
+	Val *a = get_v(&im->r);
+	bool ok = a != NULL && im->r.at == im->r.n 
+		&& a->hdr.t == VLST && a->lst.v.n == n;
+	for (size_t i=0; ok && i<n; ++i) {
+		ok = a->lst.v.v[i]->hdr.t == VLST;
+	}
+	if (ok) {
+		for (size_t i=0; i<n; ++i) {
+			v[i] = a->lst.v.v[i]->lst.v;
+			a->lst.v.v[i]->lst.v = (List_v) {0, NULL};
+		}
+	}
+	if (a != NULL) {
+		free_v(a);
+	}
+	return ok;
+}
+
+static int
+run_cached(Env *e, const char *path) {
+	/* runs the script read whole from stdin, 
+	 * with its values from the image at path if it was made from it, 
+	 * else parsed, and saved there if the script ran to its end; 
+	 * returns 1 at end of script, 0 if it failed, -1 on read error */
+	char **line = NULL;
+	size_t n = 0;
+	uint64_t src = hash_bytes(HASHSEED, IMGMAGIC, 4);
+	while (1) {
+		char *l;
+		Lrc rc = readline(stdin, &l);
+		if (rc == ERRL) {
+			free_lines(line, n);
+			return -1;
+		}
+		if (rc == ENDL) {
+			break;
+		}
+		if (rc == EMPTYL) {
+			continue;
+		}
+		line = realloc(line, (n+1) * sizeof(*line));
+		assert(line != NULL);
+		line[n++] = l;
+		src = hash_bytes(src, l, strlen(l) + 1);
+	}
+	List_v *v = calloc(n > 0 ? n : 1, sizeof(*v));
+	assert(v != NULL);
+	Image im;
+	bool hit = map_image(path, src, &im) && cached_lines(&im, n, v);
+	unmap_image(&im);
+	if (Dbg) { outf("# image %s: %s\n", path, hit ? "hit" : "miss"); }
+	int r = 1;
+	for (size_t i=0; i<n && r == 1; ++i) {
+		outf("> input: \"%s\"\n", line[i]);
+		if (!hit) {
+			Phrase *ph = phrase_of_str(line[i]);
+			if (ph == NULL) {
+				r = 0;
+				break;
+			}
+			if (Dbg) { outf("# phrase: "); print_ph(ph); }
+			phrase_begin();
+			if (!eval_ph(e, ph, v+i)) {
+				r = 0;
+			}
+			free_ph(ph);
+			if (!phrase_end()) {
+				r = 0;
+			}
+			continue;
+		}
+		phrase_begin();
+		for (size_t j=0; j<v[i].n; ++j) {
+			Val *a = v[i].v[j];
+			v[i].v[j] = NULL;
+			bool t = transition(e, a);
+			if (!t) {
+				r = 0;
+				break;
+			}
+		}
+		if (!phrase_end()) {
+			r = 0;
+		}
+	}
+	if (r == 1 && !hit) {
+		Wbuf w = {NULL, 0, 0};
+		Val a = {.lst = {VLST, {0, NULL}, 0}};
+		for (size_t i=0; i<n; ++i) {
+			Val *b = malloc(sizeof(*b));
+			assert(b != NULL);
+			b->hdr.t = VLST;
+			b->lst.v = v[i];
+			b->lst.h = 0;
+			v[i] = (List_v) {0, NULL};
+			a.lst.v = push_l(a.lst.v, b);
+		}
+		put_v(&w, &a);
+		write_image(path, src, &w);
+		free(w.b);
+		for (size_t i=0; i<a.lst.v.n; ++i) {
+			free_v(a.lst.v.v[i]);
+		}
+		free(a.lst.v.v);
+	}
+	for (size_t i=0; i<n; ++i) {
+		for (size_t j=0; j<v[i].n; ++j) {
+			if (v[i].v[j] != NULL) {
+				free_v(v[i].v[j]);
+			}
+		}
+		free(v[i].v);
+	}
+	free(v);
+	free_lines(line, n);
+	return r;
+}
+
+static int
+bye(Env *e) {
+	if (e->state != RUN) {
+		outf("? %s: unexpected end of program\n",
+				"main");
+	}
+	print_env(e, ">");
+	outf("> bye!\n");
+	free_env(e, true);
+	return EXIT_SUCCESS;
+}
+
+static int
+run_lines(Env *e, FILE *in) {
+	/* runs the lines read from in, frees e, returns the exit status */
 	char *line;
 	while (1) {
-		Lrc rc = readline(&line);
+		Lrc rc = readline(in, &line);
 		switch (rc) {
 			case ERRL:
-				printf("? %s: error\n", __FUNCTION__); 
+				outf("? %s: error\n", "main"); 
 				print_env(e, "?");
 				free_env(e, true);
 				return EXIT_FAILURE;
 			case ENDL:
-				if (e->state != RUN) {
-					printf("? %s: unexpected end of program\n",
-							__FUNCTION__);
-				}
-				print_env(e, ">");
-				printf("> bye!\n");
-				free_env(e, true);
-				return EXIT_SUCCESS;
+				return bye(e);
 			case EMPTYL:
 				continue;
 			case LINE:
-				printf("> input: \"%s\"\n", line);
+				outf("> input: \"%s\"\n", line);
 				break;
 		}
 		Phrase *ph = phrase_of_str(line);
@@ -3168,9 +8583,15 @@ main(int argc, char **argv) {
 			free_env(e, true);
 			return EXIT_FAILURE;
 		}
-		if (Dbg) { printf("# phrase: "); print_ph(ph); }
-		bool r = eval_ph(e, ph);
+		if (Dbg) { outf("# phrase: "); print_ph(ph); }
+		phrase_begin();
+		bool r = eval_ph(e, ph, NULL);
 		free_ph(ph);
+		if (!phrase_end()) {
+			/* abandoned, the session goes on */
+			e->state = RUN;
+			continue;
+		}
 		if (!r) {
 			free_env(e, true);
 			return EXIT_FAILURE;
@@ -3179,3 +8600,420 @@ main(int argc, char **argv) {
 	free_env(e, true);
 	return EXIT_SUCCESS;
 }
+
+/* --jobs: scripts in parallel, each in its own root env */
+typedef struct {
+	const char *path;
+	char *out;	/* what it printed */
+	size_t n;
+	int rc;	/* its exit status */
+	bool done;
+} Job;
+
+typedef struct {
+	Job *j;
+	size_t n;
+	size_t next;	/* to run */
+	bool dbg;
+	bool jit;
+	bool opt;
+	char *image;
+	pthread_mutex_t mx;
+	pthread_cond_t done;
+} Jobs;
+
+static void
+run_job(Jobs *a, Job *j) {
+	/* in its own context: output, limits */
+	Limits lim;
+	limits_init(&lim);
+	Lim = &lim;
+	Dbg = a->dbg;
+	Jit = a->jit;
+	Opt = a->opt;
+	Outf = open_memstream(&j->out, &j->n);
+	assert(Outf != NULL);
+	FILE *in = fopen(j->path, "r");
+	if (in == NULL) {
+		outf("? %s: %s: %s\n", "main", j->path, strerror(errno));
+		j->rc = EXIT_FAILURE;
+	} else {
+		Env *e = new_env(NULL);
+		if (a->image != NULL && !load_image(e, a->image)) {
+			free_env(e, true);
+			j->rc = EXIT_FAILURE;
+		} else {
+			j->rc = run_lines(e, in);
+		}
+		fclose(in);
+	}
+	fclose(Outf);
+	Outf = NULL;
+	Lim = &Mainlimits;
+	pthread_mutex_lock(&a->mx);
+	j->done = true;
+	pthread_cond_broadcast(&a->done);
+	pthread_mutex_unlock(&a->mx);
+}
+static void *
+job_worker(void *arg) {
+	Jobs *a = arg;
+	size_t i;
+	while ((i = __atomic_fetch_add(&a->next, 1, __ATOMIC_RELAXED)) < a->n) {
+		run_job(a, a->j + i);
+	}
+	return NULL;
+}
+static int
+run_jobs(size_t nw, char **path, size_t n, char *image) {
+	/* the n scripts at path on nw threads, their outputs in order; 
+	 * fails if one of them did */
+	Jobs a = {calloc(n > 0 ? n : 1, sizeof(Job)), n, 0, Dbg, Jit, Opt, image};
+	assert(a.j != NULL);
+	pthread_mutex_init(&a.mx, NULL);
+	pthread_cond_init(&a.done, NULL);
+	for (size_t i=0; i<n; ++i) {
+		a.j[i].path = path[i];
+	}
+	pthread_t *th = calloc(nw > 0 ? nw : 1, sizeof(*th));
+	assert(th != NULL);
+	pthread_attr_t at;
+	pthread_attr_init(&at);
+	pthread_attr_setstacksize(&at, POOLSTACK);
+	size_t nth = 0;
+	while (nth < nw && pthread_create(th + nth, &at, job_worker, &a) == 0) {
+		++nth;
+	}
+	pthread_attr_destroy(&at);
+	if (nth == 0) {
+		job_worker(&a);
+	}
+	int rc = EXIT_SUCCESS;
+	for (size_t i=0; i<n; ++i) {
+		pthread_mutex_lock(&a.mx);
+		while (!a.j[i].done) {
+			pthread_cond_wait(&a.done, &a.mx);
+		}
+		pthread_mutex_unlock(&a.mx);
+		fwrite(a.j[i].out, 1, a.j[i].n, stdout);
+		free(a.j[i].out);
+		if (a.j[i].rc != EXIT_SUCCESS) {
+			rc = EXIT_FAILURE;
+		}
+	}
+	for (size_t i=0; i<nth; ++i) {
+		pthread_join(th[i], NULL);
+	}
+	free(th);
+	pthread_cond_destroy(&a.done);
+	pthread_mutex_destroy(&a.mx);
+	free(a.j);
+	return rc;
+}
+
+/* --serve: sessions over a unix socket. Both ways, a frame is 
+ * a 4 bytes little-endian length then that many bytes. A connection 
+ * first sends the name of its session (empty for a new one, freed 
+ * at the end), then lines to evaluate, a frame each; each gets back 
+ * a frame: a status ('0' ok, '1' failed, '2' abandoned) then the output. 
+ * A named session lives as long as the server. */
+
+/* max frame size, in bytes */
+#define FRAMEMAX (16 << 20)
+
+typedef struct Session_ {
+	char name[WSZ];
+	Cs *c;
+	pthread_mutex_t mx;	/* one evaluation at a time */
+	struct Session_ *next;
+} Session;
+
+typedef struct {
+	int fd;
+	const char *image;
+	bool dbg;
+	bool jit;
+	bool opt;
+} Conn;
+
+static Session *Sessions;
+static pthread_mutex_t Sessionsmx = PTHREAD_MUTEX_INITIALIZER;
+
+static bool
+get_all(int fd, void *a, size_t n) {
+	for (size_t k=0; k<n; ) {
+		ssize_t r = read(fd, (char *)a + k, n - k);
+		if (r <= 0) {
+			if (r < 0 && errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		k += r;
+	}
+	return true;
+}
+static bool
+put_all(int fd, const void *a, size_t n) {
+	for (size_t k=0; k<n; ) {
+		ssize_t r = write(fd, (const char *)a + k, n - k);
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		k += r;
+	}
+	return true;
+}
+static char *
+get_frame(int fd) {
+	/* a frame's bytes, fresh and null ended, NULL at end or if invalid */
+	unsigned char h[4];
+	if (!get_all(fd, h, 4)) {
+		return NULL;
+	}
+	uint32_t n = h[0] | h[1] << 8 | h[2] << 16 | (uint32_t)h[3] << 24;
+	if (n > FRAMEMAX) {
+		return NULL;
+	}
+	char *a = malloc(n + 1);
+	assert(a != NULL);
+	if (!get_all(fd, a, n)) {
+		free(a);
+		return NULL;
+	}
+	a[n] = '\0';
+	return a;
+}
+static bool
+put_frame(int fd, char st, const char *a, size_t n) {
+	/* status st then n bytes of a */
+	uint32_t m = n + 1;
+	unsigned char h[5] = {m, m >> 8, m >> 16, m >> 24, st};
+	return put_all(fd, h, 5) && put_all(fd, a, n);
+}
+
+static Cs *
+session_cs(Conn *k) {
+	/* new context, with the image */
+	Cs *c = cs_new();
+	if (c == NULL) {
+		return NULL;
+	}
+	cs_debug(c, k->dbg);
+	cs_jit(c, k->jit);
+	cs_opt(c, k->opt);
+	if (k->image != NULL && !cs_image(c, k->image)) {
+		cs_free(c);
+		return NULL;
+	}
+	return c;
+}
+static Session *
+session_of(Conn *k, const char *name) {
+	/* the named session, made if new, NULL if it cannot be */
+	if (strlen(name) >= WSZ) {
+		return NULL;
+	}
+	pthread_mutex_lock(&Sessionsmx);
+	Session *s = Sessions;
+	while (s != NULL && strcmp(s->name, name) != 0) {
+		s = s->next;
+	}
+	if (s == NULL) {
+		Cs *c = session_cs(k);
+		if (c != NULL) {
+			s = calloc(1, sizeof(*s));
+			assert(s != NULL);
+			strcpy(s->name, name);
+			s->c = c;
+			pthread_mutex_init(&s->mx, NULL);
+			s->next = Sessions;
+			Sessions = s;
+		}
+	}
+	pthread_mutex_unlock(&Sessionsmx);
+	return s;
+}
+
+typedef struct {
+	char *b;
+	size_t n;
+} Outbuf;
+
+static void
+to_outbuf(void *arg, const char *a, size_t n) {
+	/* cs_eval gives its whole output at once */
+	Outbuf *o = arg;
+	o->b = malloc(n);
+	assert(o->b != NULL);
+	memcpy(o->b, a, n);
+	o->n = n;
+}
+static void *
+serve_conn(void *arg) {
+	Conn *k = arg;
+	char *name = get_frame(k->fd);
+	Session *s = NULL;
+	Cs *c = NULL;
+	if (name != NULL && strlen(name) > 0) {
+		s = session_of(k, name);
+	} else if (name != NULL) {
+		c = session_cs(k);
+	}
+	free(name);
+	if (s == NULL && c == NULL) {
+		const char *m = "? serve: no session\n";
+		put_frame(k->fd, '1', m, strlen(m));
+	}
+	char *line;
+	while ((s != NULL || c != NULL) && (line = get_frame(k->fd)) != NULL) {
+		Outbuf o = {NULL, 0};
+		if (s != NULL) {
+			pthread_mutex_lock(&s->mx);
+		}
+		Cs *cc = s != NULL ? s->c : c;
+		cs_output(cc, to_outbuf, &o);
+		cs_rc r = cs_eval(cc, line);
+		cs_output(cc, NULL, NULL);
+		if (s != NULL) {
+			pthread_mutex_unlock(&s->mx);
+		}
+		free(line);
+		bool ok = put_frame(k->fd, r == CS_OK ? '0' : r == CS_FAIL ? '1' : '2', o.b, o.n);
+		free(o.b);
+		if (!ok) {
+			break;
+		}
+	}
+	cs_free(c);
+	close(k->fd);
+	free(k);
+	return NULL;
+}
+static int
+serve(const char *path, const char *image) {
+	/* serves connections at path until killed */
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sa.sun_path)) {
+		outf("? %s: socket path too long\n", __FUNCTION__);
+		return EXIT_FAILURE;
+	}
+	strcpy(sa.sun_path, path);
+	struct stat st;
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path);	/* left by a previous server */
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 
+			|| listen(fd, 64) != 0) {
+		outf("? %s: %s: %s\n", __FUNCTION__, path, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return EXIT_FAILURE;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	pthread_attr_t at;
+	pthread_attr_init(&at);
+	pthread_attr_setstacksize(&at, POOLSTACK);
+	pthread_attr_setdetachstate(&at, PTHREAD_CREATE_DETACHED);
+	while (1) {
+		int cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			outf("? %s: %s\n", __FUNCTION__, strerror(errno));
+			break;
+		}
+		Conn *k = malloc(sizeof(*k));
+		assert(k != NULL);
+		*k = (Conn) {cfd, image, Dbg, Jit, Opt};
+		pthread_t th;
+		if (pthread_create(&th, &at, serve_conn, k) != 0) {
+			close(cfd);
+			free(k);
+		}
+	}
+	pthread_attr_destroy(&at);
+	close(fd);
+	return EXIT_FAILURE;
+}
+
+int
+main(int argc, char **argv) {
+	char *cache = NULL;
+	char *image = NULL;
+	char *sock = NULL;
+	size_t jobs = 0;
+	int i;
+	for (i=1; i<argc && jobs == 0; ++i) {
+		if (strcmp(argv[i], "--cache") == 0 && i+1 < argc) {
+			cache = argv[++i];
+		} else if (strcmp(argv[i], "--image") == 0 && i+1 < argc) {
+			image = argv[++i];
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			Jit = true;
+		} else if (strcmp(argv[i], "--opt") == 0) {
+			Opt = true;
+		} else if (strcmp(argv[i], "--trace") == 0 && i+1 < argc) {
+			if (!trace_on(argv[++i])) {
+				return EXIT_FAILURE;
+			}
+		} else if (strcmp(argv[i], "--trace-file") == 0 && i+1 < argc) {
+			Tracefile = argv[++i];
+		} else if (strcmp(argv[i], "--fuel") == 0 && i+1 < argc) {
+			Fuel = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--timeout") == 0 && i+1 < argc) {
+			Timeout = strtol(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--depth") == 0 && i+1 < argc) {
+			Maxdepth = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--serve") == 0 && i+1 < argc) {
+			sock = argv[++i];
+		} else if (strcmp(argv[i], "--jobs") == 0 && i+1 < argc) {
+			/* the arguments left are scripts */
+			jobs = strtoul(argv[++i], NULL, 10);
+			if (jobs == 0) {
+				jobs = 1;
+			}
+		} else if (strcmp(argv[i], "--decode") == 0 && i+1 < argc) {
+			return trace_decode(argv[++i]) ? EXIT_SUCCESS : EXIT_FAILURE;
+		} else {
+			Dbg = true;
+		}
+	}
+	limits_init(&Mainlimits);
+	limits_on();
+	if (jobs > 0) {
+		return run_jobs(jobs, argv + i, argc - i, image);
+	}
+	if (sock != NULL) {
+		return serve(sock, image);
+	}
+	/* initialize root env */
+	Env *e = new_env(NULL);
+	if (image != NULL && !load_image(e, image)) {
+		free_env(e, true);
+		return EXIT_FAILURE;
+	}
+	if (cache != NULL) {
+		int r = run_cached(e, cache);
+		if (r < 0) {
+			outf("? %s: error\n", __FUNCTION__); 
+			print_env(e, "?");
+		}
+		if (r <= 0) {
+			free_env(e, true);
+			return EXIT_FAILURE;
+		}
+		return bye(e);
+	}
+	return run_lines(e, stdin);
+}
+
+#endif
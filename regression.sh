@@ -4,7 +4,8 @@ TDIR="tests"
 for t in $(ls $TDIR/t*); do
 	OUT="$TDIR/out-$(basename $t)"
 	REF="$TDIR/ref-$(basename $t)"
-	./a.out <$t >$OUT
+	./a.out "$@" <$t >$OUT
+	rm -f $t-*	# files the test wrote, as $TDIR/tN-...
 	diff $OUT $REF
 	if [ $? != 0 ]; then 
 		echo "$t FAILED"
@@ -13,3 +14,91 @@ for t in $(ls $TDIR/t*); do
 	fi
 done
 
+
+# compiled code keeps to the limits: same output as interpreted
+for o in "--fuel 100000" "--depth 100" "--timeout 100000"; do
+	./a.out $o <$TDIR/t113 >$TDIR/out-limits
+	./a.out --jit $o <$TDIR/t113 | diff $TDIR/out-limits -
+	if [ $? != 0 ]; then 
+		echo "t113 --jit $o FAILED"
+	else
+		echo "t113 --jit $o ok"
+	fi
+done
+
+# traced runs decode to the events of the categories asked for
+for c in "all:call force line loop reduce state trans" "call,loop:call loop"; do
+	./a.out --trace ${c%%:*} --trace-file $TDIR/t114-trace <$TDIR/t114 >/dev/null
+	./a.out --decode $TDIR/t114-trace | awk '{print $3}' | sort -u | xargs \
+		| diff - <(echo ${c#*:})
+	if [ $? != 0 ]; then 
+		echo "t114 --trace ${c%%:*} FAILED"
+	else
+		echo "t114 --trace ${c%%:*} ok"
+	fi
+	rm -f $TDIR/t114-trace
+done
+if ./a.out --decode $TDIR/t114 >/dev/null; then
+	echo "t114 --decode of a script FAILED"
+else
+	echo "t114 --decode of a script ok"
+fi
+
+# an image gives back what was saved in it: closures, lazy and packed 
+# sequences, vectors, big naturals
+./a.out <$TDIR/t115 >/dev/null
+./a.out --image $TDIR/t115-img.bin <<EOF | diff - $TDIR/ref-t115-image
+add10 (5,) ; print it
+adder (-1,) ; it (5,) ; print it
+at big 2999 ; print it
+fold + 0 packed ; print it
+at vec 1 ; print it
+at vec 3 ; print it
+huge + 1 ; print it
+call 100 k
+scale (2,) ; print it
+EOF
+if [ $? != 0 ]; then 
+	echo "t115 --image FAILED"
+else
+	echo "t115 --image ok"
+fi
+rm -f $TDIR/t115-*
+
+# --cache: a second run takes its values from what the first saved, 
+# a changed script is read again, then saved for the next run
+C=$TDIR/t114-cache
+rm -f $C
+for s in "" "" "down (5,) ; print it" "down (5,) ; print it"; do
+	(cat $TDIR/t114; [ -n "$s" ] && echo "$s") | ./a.out --cache $C x >$TDIR/out-cache
+	grep "^# image" $TDIR/out-cache | cut -d' ' -f4
+	(cat $TDIR/t114; [ -n "$s" ] && echo "$s") | ./a.out | diff - <(grep -v "^#" $TDIR/out-cache) >/dev/null \
+		|| echo "output differs"
+done | xargs | diff - <(echo miss hit miss hit)
+if [ $? != 0 ]; then 
+	echo "t114 --cache FAILED"
+else
+	echo "t114 --cache ok"
+fi
+rm -f $C
+
+# --serve: framing, a named session shared by connections, 
+# a failed line kept in its session, a frame over 16MB closing it
+cc -o $TDIR/client $TDIR/client.c
+S=$TDIR/serve-sock
+./a.out --serve $S >/dev/null &
+P=$!
+for k in $(seq 50); do [ -S $S ] && break; sleep 0.1; done
+{
+	$TDIR/client $S s "call 5 x" "x + 1 ; print it"
+	$TDIR/client $S s "x * 2 ; print it" "$(printf 'call 2 y\ny + x ; print it')"
+	$TDIR/client $S "" "x ; print it" "-split 1 + 1 ; print it" "-over" "3 ; print it"
+	$TDIR/client $S s "y ; print it"
+} | diff - $TDIR/ref-serve
+if [ $? != 0 ]; then 
+	echo "serve FAILED"
+else
+	echo "serve ok"
+fi
+kill $P
+rm -f $S $TDIR/client
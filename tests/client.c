@@ -0,0 +1,99 @@
+/* client of phrase --serve, for regression.sh:
+ * client path name frame... sends the session name, then each frame,
+ * and prints the status and the output of each answer.
+ * A frame "-split ..." is sent a byte at a time,
+ * "-over" announces a frame past the 16MB a server takes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define FRAMEMAX (16 << 20)
+
+static bool
+put_all(int fd, const void *a, size_t n, bool split) {
+	for (size_t k=0; k<n; ) {
+		ssize_t r = write(fd, (const char *)a + k, split ? 1 : n - k);
+		if (r <= 0) {
+			return false;
+		}
+		k += r;
+	}
+	return true;
+}
+static bool
+put_head(int fd, uint32_t n, bool split) {
+	unsigned char h[4] = {n, n >> 8, n >> 16, n >> 24};
+	return put_all(fd, h, 4, split);
+}
+static bool
+put_frame(int fd, const char *a, bool split) {
+	return put_head(fd, strlen(a), split) && put_all(fd, a, strlen(a), split);
+}
+static bool
+get_all(int fd, void *a, size_t n) {
+	for (size_t k=0; k<n; ) {
+		ssize_t r = read(fd, (char *)a + k, n - k);
+		if (r <= 0) {
+			return false;
+		}
+		k += r;
+	}
+	return true;
+}
+static bool
+get_frame(int fd) {
+	/* an answer, printed; false at end */
+	unsigned char h[4];
+	if (!get_all(fd, h, 4)) {
+		return false;
+	}
+	uint32_t n = h[0] | h[1] << 8 | h[2] << 16 | (uint32_t)h[3] << 24;
+	char *a = malloc(n + 1);
+	if (a == NULL || n == 0 || !get_all(fd, a, n)) {
+		free(a);
+		return false;
+	}
+	a[n] = '\0';
+	printf("[%c] %s%s", a[0], a + 1, n > 1 && a[n-1] == '\n' ? "" : "\n");
+	free(a);
+	return true;
+}
+
+int
+main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: client path name frame...\n");
+		return EXIT_FAILURE;
+	}
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, argv[1], sizeof(sa.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	put_frame(fd, argv[2], false);
+	for (int i=3; i<argc; ++i) {
+		bool ok;
+		if (strcmp(argv[i], "-over") == 0) {
+			ok = put_head(fd, FRAMEMAX + 1, false);
+		} else if (strncmp(argv[i], "-split ", 7) == 0) {
+			ok = put_frame(fd, argv[i] + 7, true);
+		} else {
+			ok = put_frame(fd, argv[i], false);
+		}
+		if (!ok || !get_frame(fd)) {
+			printf("closed\n");
+			break;
+		}
+	}
+	close(fd);
+	return EXIT_SUCCESS;
+}